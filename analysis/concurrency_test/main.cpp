@@ -0,0 +1,145 @@
+// Requests pages, blocks, minimap tiles and analysis status from several threads while
+// the results of the binaries evict each other, and checks every response against the
+// one made on a single thread before. Needs at least two binaries to evict, e.g.
+//   ./ConcurrencyTest ../../sample_inputs/bin/bubble-O0 ../../sample_inputs/bin/eg1-O3
+#include <atomic>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include <compression.hpp>
+#include <dyninst_wrapper.hpp>
+#include <json_converter.hpp>
+#include <page_cache.hpp>
+
+using std::vector, std::string, std::cout, std::endl;
+
+#define THREADS 8
+#define REQUESTS_PER_THREAD 500
+#define TILE_BUCKETS 64
+
+// The responses of one binary, made on a single thread
+struct Expected {
+  string binaryPath;
+  vector<string> pages[2];                      // by order and page
+  vector<std::pair<string, string>> blocks[2];  // (id, body) by order
+  string tiles[2];                              // of the whole order
+};
+
+string tileBody(const BinaryCacheResult &res, const BLOCK_ORDER order) {
+  const auto &blocks = order == MEMORY_ORDER ? res.disassembly.memory_order_blocks : res.disassembly.loop_order_blocks;
+  auto tile = MinimapTile();
+  if (!getMinimapTile(res, order, 0, blocks.size(), TILE_BUCKETS, tile)) return "";
+  return convertMinimapTile(tile).dump();
+}
+
+bool expectedResponses(const string &binaryPath, Expected &expected) {
+  expected.binaryPath = binaryPath;
+  const auto res = decodeBinaryCache(binaryPath, false);
+  if (!res) return false;
+  for (const auto order : {MEMORY_ORDER, LOOP_ORDER}) {
+    expected.tiles[order] = tileBody(*res, order);
+    auto page = DisassemblyPage();
+    for (int pageNo = 0; getDisassemblyPage(binaryPath, false, order, pageNo, page); pageNo++) {
+      expected.pages[order].push_back(serializeDisassemblyPage(page));
+      if (page.isLast) break;
+    }
+    const auto &blocks = order == MEMORY_ORDER ? res->disassembly.memory_order_blocks : res->disassembly.loop_order_blocks;
+    for (const auto &b : blocks) {
+      auto block = DisassemblyBlock();
+      if (!getDisassemblyBlockById(binaryPath, false, order, b.name, block)) return false;
+      expected.blocks[order].emplace_back(b.name, serializeDisassemblyBlock(block));
+    }
+  }
+  return true;
+}
+
+// One random request. False if its response differs from the expected one.
+bool request(const Expected &expected, PageCache &pageCache, std::mt19937 &random) {
+  const auto &binaryPath = expected.binaryPath;
+  const auto order = BLOCK_ORDER(random() % 2);
+  switch (random() % 5) {
+    case 0: {
+      if (expected.pages[order].empty()) return true;
+      const auto pageNo = int(random() % expected.pages[order].size());
+      auto page = DisassemblyPage();
+      return getDisassemblyPage(binaryPath, false, order, pageNo, page) &&
+             serializeDisassemblyPage(page) == expected.pages[order][pageNo];
+    }
+    case 1: {
+      // Through the page cache, as the server answers page requests
+      if (expected.pages[order].empty()) return true;
+      const auto pageNo = int(random() % expected.pages[order].size());
+      auto page = DisassemblyPage();
+      if (!getDisassemblyPage(binaryPath, false, order, pageNo, page)) return false;
+      auto key = PageCache::Key(binaryPath, page.binaryHash, order, pageNo, 0, CODING_IDENTITY);
+      auto body = pageCache.get(key);
+      if (!body) {
+        body = std::make_shared<const EncodedBody>(encodeBody(serializeDisassemblyPage(page), CODING_IDENTITY));
+        pageCache.put(key, body);
+      }
+      return body->data == expected.pages[order][pageNo];
+    }
+    case 2: {
+      if (expected.blocks[order].empty()) return true;
+      const auto &[id, expectedBody] = expected.blocks[order][random() % expected.blocks[order].size()];
+      auto block = DisassemblyBlock();
+      return getDisassemblyBlockById(binaryPath, false, order, id, block) && serializeDisassemblyBlock(block) == expectedBody;
+    }
+    case 3: {
+      const auto res = decodeBinaryCache(binaryPath, false);
+      return res && tileBody(*res, order) == expected.tiles[order];
+    }
+    default:
+      return getAnalysisStatus(binaryPath, false).phase != PHASE_FAILED;
+  }
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    cout << "Usage: " << argv[0] << " <binary> <binary>..." << endl;
+    return 1;
+  }
+
+  // Every result stored evicts all others, which are reloaded from the on-disk cache
+  const auto cacheDir = std::filesystem::temp_directory_path() / ("dis-viz-concurrency-test-" + std::to_string(getpid()));
+  auto options = AnalysisOptions();
+  options.cacheDir = cacheDir.string();
+  options.cacheMemoryLimit = 1;
+  setAnalysisOptions(options);
+
+  auto expected = vector<Expected>(argc - 1);
+  for (int i = 1; i < argc; i++) {
+    if (!expectedResponses(argv[i], expected[i - 1])) {
+      cout << argv[i] << ": analysis failed" << endl;
+      std::filesystem::remove_all(cacheDir);
+      return 1;
+    }
+  }
+
+  // Small enough that cached pages are dropped too
+  auto pageCache = PageCache(256 << 10);
+  auto failures = std::atomic<size_t>(0);
+  auto threads = vector<std::thread>();
+  for (unsigned int t = 0; t < THREADS; t++) {
+    threads.emplace_back([&, t] {
+      auto random = std::mt19937(t);
+      for (int r = 0; r < REQUESTS_PER_THREAD; r++)
+        if (!request(expected[random() % expected.size()], pageCache, random)) failures++;
+    });
+  }
+  for (auto &thread : threads) thread.join();
+  std::filesystem::remove_all(cacheDir);
+
+  if (failures > 0) {
+    cout << "FAILED " << failures << " of " << THREADS * REQUESTS_PER_THREAD << " responses differ" << endl;
+    return 1;
+  }
+  cout << "OK " << THREADS * REQUESTS_PER_THREAD << " responses" << endl;
+  return 0;
+}
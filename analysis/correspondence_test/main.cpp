@@ -8,6 +8,8 @@
 #include <InstructionDecoder.h>
 #include <Symtab.h>
 
+#include <line_table.hpp>
+
 using std::vector, std::string, std::ifstream, std::stringstream, std::cout, std::endl, std::make_unique;
 
 namespace InstructionAPI = Dyninst::InstructionAPI;
@@ -30,6 +32,7 @@ int main(int argc, char **argv) {
   co->parse();
 
   auto funcs = co->funcs();
+  auto lineTable = LineTable(symtab);
 
   // create an Instruction decoder
   auto anyfunc = *funcs.begin();
@@ -46,15 +49,13 @@ int main(int argc, char **argv) {
       auto raw_insnptr =
             (const unsigned char *)f->isrc()->getPtrToInstruction(icur);
         auto instr = decoder.decode(raw_insnptr);
-        auto cur_lines = vector<SymtabAPI::Statement::Ptr>();
-        symtab->getSourceLines(cur_lines, icur); // getSourceLines should give multiple source lines per instruction.
-        for (const auto &line : cur_lines) {
+        for (const auto &line : lineTable.at(icur)) { // an instruction can have multiple source lines
           // 0x1234: push %rbp (main.cpp:10)
-          auto sourcePath = line->getFile();
+          const auto &sourcePath = *line.file;
           auto sourceFile = sourcePath.substr(sourcePath.find_last_of("/") + 1);
           cout << "0x" << std::hex << icur << std::dec << ":" << 
           // instr.format() << 
-          "\t(" << sourceFile << ":" << line->getLine() << ")" << endl;
+          "\t(" << sourceFile << ":" << line.line << ")" << endl;
         }
         icur += instr.size();
       }
@@ -0,0 +1,76 @@
+// Measures the resident memory of the instruction flags of a binary stored as InstructionFlags
+// bitmasks against the unordered_set<INSTRUCTION_FLAGS> they replaced, with two copies per
+// instruction as the analysis keeps them: in its InstructionInfo and in its DecodedInstruction.
+// Also prints the peak resident memory of the analysis. Run it on a large binary, e.g.
+//   ./FlagsMemory ../../sample_inputs/bin/eg1-O3
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <unordered_set>
+#include <vector>
+
+#include <dyninst_wrapper.hpp>
+
+using std::vector, std::string, std::cout, std::endl, std::unordered_set;
+
+// Resident bytes of the process now
+size_t residentBytes() {
+  auto pages = size_t(0), resident = size_t(0);
+  std::ifstream("/proc/self/statm") >> pages >> resident;
+  return resident * sysconf(_SC_PAGESIZE);
+}
+
+size_t peakResidentBytes() {
+  auto usage = rusage();
+  getrusage(RUSAGE_SELF, &usage);
+  return size_t(usage.ru_maxrss) * 1024;
+}
+
+double toMB(const size_t bytes) { return bytes / double(1 << 20); }
+
+// Resident bytes the flags of every instruction take as two copies of Flags
+template <typename Flags, typename ToFlags>
+size_t flagsBytes(const vector<InstructionFlags> &instructions, ToFlags toFlags) {
+  const auto before = residentBytes();
+  auto instructionInfos = vector<Flags>();
+  auto decodedInstructions = vector<Flags>();
+  for (const auto &flags : instructions) {
+    instructionInfos.push_back(toFlags(flags));
+    decodedInstructions.push_back(toFlags(flags));
+  }
+  return residentBytes() - before;
+}
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    cout << "Usage: " << argv[0] << " <binary>" << endl;
+    return 1;
+  }
+
+  const auto binaryPath = string(argv[1]);
+  auto instructions = vector<InstructionFlags>();
+  {
+    const auto res = decodeBinaryCache(binaryPath, false);
+    if (!res) {
+      cout << binaryPath << ": analysis failed" << endl;
+      return 1;
+    }
+    for (const auto &block : res->disassembly.memory_order_blocks)
+      for (const auto &instr : block.instructions) instructions.push_back(instr.flags);
+  }
+  cout << binaryPath << ": " << instructions.size() << " instructions, peak resident memory of the analysis "
+       << toMB(peakResidentBytes()) << " MB" << endl;
+
+  // The bitmasks first, so the hash sets measured after them can reuse at most their few pages
+  const auto bitmaskBytes = flagsBytes<InstructionFlags>(instructions, [](const InstructionFlags flags) { return flags; });
+  const auto setBytes = flagsBytes<unordered_set<INSTRUCTION_FLAGS>>(instructions, [](const InstructionFlags flags) {
+    auto set = unordered_set<INSTRUCTION_FLAGS>();
+    for (int flag = INST_VECTORIZED; flag <= INST_FP; flag++)
+      if (flags.contains(INSTRUCTION_FLAGS(flag))) set.insert(INSTRUCTION_FLAGS(flag));
+    return set;
+  });
+  cout << "flags as unordered_set: " << toMB(setBytes) << " MB, as InstructionFlags: " << toMB(bitmaskBytes) << " MB" << endl;
+  return 0;
+}
@@ -0,0 +1,73 @@
+// Checks that blocks serialized by concurrent blockFragment calls are the same bytes
+// as blocks serialized one after the other on a single thread.
+// Run it on the binaries of sample_inputs/compile.sh, e.g.
+//   ./FragmentTest ../../sample_inputs/bin/bubble-O0 ../../sample_inputs/bin/eg1-O3
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dyninst_wrapper.hpp>
+#include <json_converter.hpp>
+
+using std::vector, std::string, std::cout, std::endl;
+
+#define ROUNDS 4
+
+// Every thread requests every block, each thread in its own order, so most
+// fragments are requested by several threads at once
+bool checkConcurrent(const vector<const BlockInfo *> &blocks, const vector<string> &expected, const unsigned int nThreads) {
+  auto fragments = vector<string>(blocks.size());
+  auto mismatches = std::atomic<size_t>(0);
+  auto threads = vector<std::thread>();
+  for (unsigned int t = 0; t < nThreads; t++) {
+    threads.emplace_back([&, t] {
+      auto order = vector<size_t>(blocks.size());
+      std::iota(order.begin(), order.end(), 0);
+      std::shuffle(order.begin(), order.end(), std::mt19937(t));
+      for (const auto i : order)
+        if (blockFragment(*blocks[i], fragments[i]) != expected[i]) mismatches++;
+    });
+  }
+  for (auto &thread : threads) thread.join();
+
+  for (size_t i = 0; i < blocks.size(); i++)
+    if (fragments[i] != expected[i]) mismatches++;
+  if (mismatches > 0) cout << mismatches << " fragments differ from the single-threaded ones" << endl;
+  return mismatches == 0;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    cout << "Usage: " << argv[0] << " <binary>..." << endl;
+    return 1;
+  }
+
+  const auto nThreads = std::max(4u, std::thread::hardware_concurrency());
+  auto failed = false;
+  for (int i = 1; i < argc; i++) {
+    const auto binaryPath = string(argv[i]);
+    const auto res = decodeBinaryCache(binaryPath, false);
+    if (!res) {
+      cout << binaryPath << ": analysis failed" << endl;
+      failed = true;
+      continue;
+    }
+
+    auto blocks = vector<const BlockInfo *>();
+    for (const auto &block : res->disassembly.memory_order_blocks) blocks.push_back(&block);
+    for (const auto &block : res->disassembly.loop_order_blocks) blocks.push_back(&block);
+    auto expected = vector<string>();
+    for (const auto *block : blocks) expected.push_back(convertBlockInfo(*block).dump());
+
+    auto ok = true;
+    for (int round = 0; round < ROUNDS && ok; round++) ok = checkConcurrent(blocks, expected, nThreads);
+    cout << (ok ? "OK " : "FAILED ") << binaryPath << endl;
+    failed |= !ok;
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,291 @@
+// Checks the memory order and loop order laid out by the analysis, pseudo loop blocks
+// included, against the linear algorithm they replaced, run here on the same loops.
+// Run it on the binaries of sample_inputs/compile.sh, e.g.
+//   ./LayoutTest ../../sample_inputs/bin/bubble-O0 ../../sample_inputs/bin/eg1-O3
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include <CodeObject.h>
+#include <Symtab.h>
+
+#include <dyninst_wrapper.hpp>
+
+using std::vector, std::string, std::cout, std::endl, std::make_unique, std::unordered_map;
+
+namespace ParseAPI = Dyninst::ParseAPI;
+namespace SymtabAPI = Dyninst::SymtabAPI;
+
+// The block ids of the analysis: a running number over the blocks of every
+// function, in CodeObject::funcs() order. Reference blocks are named "B<id>".
+using BlockIds = unordered_map<const ParseAPI::Block *, int>;
+
+int blockId(const string &name) { return std::stoi(name.substr(name.find_last_of('B') + 1)); }
+
+LoopEntry referenceLoopEntry(const BlockIds &ids, ParseAPI::LoopTreeNode &lt) {
+  auto loop_entry = LoopEntry();
+  if (lt.loop) {
+    auto backedges = vector<ParseAPI::Edge *>();
+    auto blocks = vector<ParseAPI::Block *>();
+    auto entries = vector<ParseAPI::Block *>();
+    lt.loop->getBackEdges(backedges);
+    lt.loop->getLoopBasicBlocks(blocks);
+    lt.loop->getLoopEntries(entries);
+    loop_entry.name = lt.name();
+    loop_entry.header_block = entries.empty() ? "" : "B" + std::to_string(ids.at(entries[0]));
+    for (auto &e : backedges)
+      loop_entry.backedges.emplace_back("B" + std::to_string(ids.at(e->src())), "B" + std::to_string(ids.at(e->trg())));
+    for (auto &block : blocks) loop_entry.blocks.push_back("B" + std::to_string(ids.at(block)));
+  }
+  for (auto &i : lt.children) loop_entry.loops.push_back(referenceLoopEntry(ids, *i));
+  return loop_entry;
+}
+
+void referenceAddLoopsToBlocks(vector<BlockInfo> &blocks, const LoopEntry &loop, unordered_map<string, int> &loop_count) {
+  for (auto &block : blocks) {
+    if (std::find(loop.blocks.begin(), loop.blocks.end(), block.name) == loop.blocks.end()) continue;
+    auto innerLoopIt = loop.loops.begin();
+    for (; innerLoopIt != loop.loops.end(); innerLoopIt++)
+      if (std::find(innerLoopIt->blocks.begin(), innerLoopIt->blocks.end(), block.name) != innerLoopIt->blocks.end()) break;
+    if (innerLoopIt == loop.loops.end()) loop_count[loop.name]++;
+    block.loops.push_back({loop.name, loop_count[loop.name], -1});
+    for (const auto &backedge : loop.backedges)
+      if (backedge.first == block.name) block.backedges.push_back(backedge.second);
+  }
+  for (const auto &innerLoop : loop.loops) referenceAddLoopsToBlocks(blocks, innerLoop, loop_count);
+}
+
+// The pseudo loop blocks, inserted after the block that leaves its innermost loop early
+void referencePseudoLoops(vector<BlockInfo> &funcBlocks) {
+  auto processed_loops = vector<string>();
+  size_t idx = 0;
+  while (idx + 1 < funcBlocks.size()) {
+    if (funcBlocks[idx].loops.size() > 0 &&
+        std::find(processed_loops.begin(), processed_loops.end(), funcBlocks[idx].loops.back().name) != processed_loops.end()) {
+      idx++;
+      continue;
+    }
+    auto blockLoopNames = vector<string>();
+    for (const auto &l : funcBlocks[idx].loops) blockLoopNames.push_back(l.name);
+    auto nextBlockLoopNames = vector<string>();
+    for (const auto &l : funcBlocks[idx + 1].loops) nextBlockLoopNames.push_back(l.name);
+
+    if (std::all_of(nextBlockLoopNames.begin(), nextBlockLoopNames.end(), [&blockLoopNames](const string &l) {
+          return std::find(blockLoopNames.begin(), blockLoopNames.end(), l) != blockLoopNames.end();
+        }) && blockLoopNames.size() > nextBlockLoopNames.size()) {
+      if (funcBlocks[idx].loops.back().loopCount != funcBlocks[idx].loops.back().loopTotal) {
+        auto pseudo_blocks = vector<BlockInfo>();
+        for (auto it = funcBlocks.begin() + (idx + 1); it != funcBlocks.end(); it++) {
+          if (it->loops.size() > 0 && it->loops.back().name == funcBlocks[idx].loops.back().name) {
+            auto pseudoBlock = *it;
+            pseudoBlock.block_type = BlockInfo::BLOCK_TYPE_PSEUDOLOOP;
+            pseudo_blocks.push_back(std::move(pseudoBlock));
+            if (pseudo_blocks.back().loops.back().loopCount == pseudo_blocks.back().loops.back().loopTotal) break;
+          }
+        }
+        processed_loops.push_back(funcBlocks[idx].loops.back().name);
+        idx++;
+        auto skips = pseudo_blocks.size();
+        funcBlocks.insert(funcBlocks.begin() + idx, pseudo_blocks.begin(), pseudo_blocks.end());
+        idx += skips;
+      }
+    }
+    idx++;
+  }
+}
+
+vector<unsigned int> referenceBlocksInLoop(const vector<BlockInfo> &funcBlocks, const vector<unsigned int> &blocks,
+                                           const LoopEntry &loop, vector<unsigned int> &visitedBlocks) {
+  auto blocksInLoop = vector<unsigned int>();
+  auto currLoopBlocks = vector<unsigned int>();
+  std::copy_if(blocks.begin(), blocks.end(), std::back_inserter(currLoopBlocks), [&loop, &funcBlocks](const unsigned int b) {
+    return std::find(loop.blocks.begin(), loop.blocks.end(), funcBlocks[b].name) != loop.blocks.end();
+  });
+  for (const auto &block : currLoopBlocks) {
+    if (std::find(visitedBlocks.begin(), visitedBlocks.end(), block) != visitedBlocks.end()) continue;
+    auto innerLoopIt = loop.loops.begin();
+    for (; innerLoopIt != loop.loops.end(); ++innerLoopIt) {
+      if (std::find(innerLoopIt->blocks.begin(), innerLoopIt->blocks.end(), funcBlocks[block].name) != innerLoopIt->blocks.end()) {
+        auto innerLoopBlocks = referenceBlocksInLoop(funcBlocks, blocks, *innerLoopIt, visitedBlocks);
+        blocksInLoop.insert(blocksInLoop.end(), innerLoopBlocks.begin(), innerLoopBlocks.end());
+        break;
+      }
+    }
+    if (innerLoopIt == loop.loops.end()) {
+      visitedBlocks.push_back(block);
+      blocksInLoop.push_back(block);
+    }
+  }
+  auto header_block_it = std::find_if(blocksInLoop.begin(), blocksInLoop.end(), [&loop, &funcBlocks](const unsigned int b) {
+    return loop.header_block == funcBlocks[b].name;
+  });
+  if (header_block_it != blocksInLoop.end()) {
+    auto tmp = vector<unsigned int>{*header_block_it};
+    for (auto &b : blocksInLoop)
+      if (b != *header_block_it) tmp.push_back(b);
+    blocksInLoop = std::move(tmp);
+  }
+  return blocksInLoop;
+}
+
+vector<BlockInfo> referenceLoopOrder(const vector<BlockInfo> &funcBlocks, const vector<LoopEntry> &funcLoops) {
+  auto visitedBlocks = vector<unsigned int>();
+  auto funcLoopOrderBlocks = vector<BlockInfo>();
+  for (unsigned int i = 0; i < funcBlocks.size(); i++) {
+    if (std::find(visitedBlocks.begin(), visitedBlocks.end(), i) != visitedBlocks.end()) continue;
+    if (funcBlocks[i].loops.empty()) {
+      visitedBlocks.push_back(i);
+      funcLoopOrderBlocks.push_back(funcBlocks[i]);
+      continue;
+    }
+    auto foundLoop = std::find_if(funcLoops.begin(), funcLoops.end(), [&](const LoopEntry &l) {
+      return std::any_of(funcBlocks[i].loops.begin(), funcBlocks[i].loops.end(), [&l](const BlockLoopState &bl) { return bl.name == l.name; });
+    });
+    auto currLoop = foundLoop != funcLoops.end() ? *foundLoop : LoopEntry();
+    auto currLoopBlocks = vector<unsigned int>();
+    for (unsigned int b = 0; b < funcBlocks.size(); b++)
+      if (std::find(currLoop.blocks.begin(), currLoop.blocks.end(), funcBlocks[b].name) != currLoop.blocks.end())
+        currLoopBlocks.push_back(b);
+    for (auto b : referenceBlocksInLoop(funcBlocks, currLoopBlocks, currLoop, visitedBlocks))
+      funcLoopOrderBlocks.push_back(funcBlocks[b]);
+  }
+
+  // remove normal blocks if there is a pseudo block. The position is kept across
+  // the erasures, which the analysis used to lose when erasing before it.
+  for (auto it = funcLoopOrderBlocks.begin(); it != funcLoopOrderBlocks.end(); it++) {
+    if (it->block_type != BlockInfo::BLOCK_TYPE_PSEUDOLOOP) continue;
+    auto blockName = it->name;
+    auto position = it - funcLoopOrderBlocks.begin();
+    for (auto it2 = funcLoopOrderBlocks.begin(); it2 != funcLoopOrderBlocks.end();) {
+      if (it2->name == blockName && it2->block_type == BlockInfo::BLOCK_TYPE_NORMAL) {
+        if (it2 - funcLoopOrderBlocks.begin() < position) position--;
+        it2 = funcLoopOrderBlocks.erase(it2);
+      } else {
+        it2++;
+      }
+    }
+    it = funcLoopOrderBlocks.begin() + position;
+  }
+  return funcLoopOrderBlocks;
+}
+
+// The memory order of every function and the loop order of the binary
+struct ReferenceLayout {
+  vector<vector<BlockInfo>> memoryOrder; // by function
+  vector<BlockInfo> loopOrder;
+  unordered_map<int, size_t> functionOf; // block id -> function
+};
+
+ReferenceLayout referenceLayout(const ParseAPI::CodeObject::funclist &funcs) {
+  auto layout = ReferenceLayout();
+  auto curr_block_id = 0;
+  for (const auto &f : funcs) {
+    auto ids = BlockIds();
+    auto funcBlocks = vector<BlockInfo>();
+    for (const auto &block : f->blocks()) {
+      ids[block] = curr_block_id;
+      layout.functionOf[curr_block_id] = layout.memoryOrder.size();
+      auto blockInfo = BlockInfo{"B" + std::to_string(curr_block_id++)};
+      blockInfo.startAddress = block->start();
+      funcBlocks.push_back(std::move(blockInfo));
+    }
+
+    auto funcLoops = vector<LoopEntry>();
+    auto lt = std::unique_ptr<ParseAPI::LoopTreeNode>(f->getLoopTree());
+    if (lt) funcLoops = referenceLoopEntry(ids, *lt).loops;
+    for (const auto &loop : funcLoops) {
+      auto loop_count = unordered_map<string, int>();
+      referenceAddLoopsToBlocks(funcBlocks, loop, loop_count);
+      for (auto &block : funcBlocks)
+        for (auto &blockLoop : block.loops)
+          if (loop_count.find(blockLoop.name) != loop_count.end()) blockLoop.loopTotal = loop_count[blockLoop.name];
+    }
+    std::sort(funcBlocks.begin(), funcBlocks.end(), [](const BlockInfo &a, const BlockInfo &b) {
+      return a.startAddress < b.startAddress;
+    });
+    referencePseudoLoops(funcBlocks);
+
+    auto loopOrder = referenceLoopOrder(funcBlocks, funcLoops);
+    layout.loopOrder.insert(layout.loopOrder.end(), loopOrder.begin(), loopOrder.end());
+    layout.memoryOrder.push_back(std::move(funcBlocks));
+  }
+  return layout;
+}
+
+// What the layout decides about a block
+using BlockLayout = std::tuple<int, int, vector<std::tuple<string, int, int>>, vector<int>>;
+
+BlockLayout blockLayout(const BlockInfo &block) {
+  auto loops = vector<std::tuple<string, int, int>>();
+  for (const auto &l : block.loops) loops.emplace_back(l.name, l.loopCount, l.loopTotal);
+  auto backedges = vector<int>();
+  for (const auto &b : block.backedges) backedges.push_back(blockId(b));
+  return {blockId(block.name), block.block_type, loops, backedges};
+}
+
+bool same(const string &what, const vector<BlockInfo> &expected, const vector<BlockInfo> &actual) {
+  if (expected.size() != actual.size()) {
+    cout << what << ": " << actual.size() << " blocks, expected " << expected.size() << endl;
+    return false;
+  }
+  for (size_t i = 0; i < expected.size(); i++) {
+    if (blockLayout(expected[i]) != blockLayout(actual[i])) {
+      cout << what << ": first difference at " << i << ", " << actual[i].name << endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    cout << "Usage: " << argv[0] << " <binary>..." << endl;
+    return 1;
+  }
+
+  auto failed = false;
+  for (int i = 1; i < argc; i++) {
+    const auto binaryPath = string(argv[i]);
+    // The analysis closes its Symtab when done, which openFile would share with this one
+    const auto res = decodeBinaryCache(binaryPath, false);
+    if (!res) {
+      cout << binaryPath << ": analysis failed" << endl;
+      failed = true;
+      continue;
+    }
+
+    SymtabAPI::Symtab *symtab;
+    if (!SymtabAPI::Symtab::openFile(symtab, binaryPath)) {
+      cout << binaryPath << ": can not be opened" << endl;
+      failed = true;
+      continue;
+    }
+    auto sts = make_unique<ParseAPI::SymtabCodeSource>(const_cast<char *>(binaryPath.c_str()));
+    auto co = make_unique<ParseAPI::CodeObject>(sts.get());
+    co->parse();
+    const auto reference = referenceLayout(co->funcs());
+
+    // Functions are interleaved in the memory order by start address, keeping their own order
+    auto memoryOrder = vector<vector<BlockInfo>>(reference.memoryOrder.size());
+    auto ok = true;
+    for (const auto &block : res->disassembly.memory_order_blocks) {
+      auto function = reference.functionOf.find(blockId(block.name));
+      if (function == reference.functionOf.end()) {
+        cout << "memory_order: " << block.name << " is not a block of the binary" << endl;
+        ok = false;
+        break;
+      }
+      memoryOrder[function->second].push_back(block);
+    }
+    for (size_t f = 0; ok && f < memoryOrder.size(); f++)
+      ok &= same("memory_order of function " + std::to_string(f), reference.memoryOrder[f], memoryOrder[f]);
+    ok &= same("loop_order", reference.loopOrder, res->disassembly.loop_order_blocks);
+    cout << (ok ? "OK " : "FAILED ") << binaryPath << endl;
+    failed |= !ok;
+  }
+  return failed ? 1 : 0;
+}
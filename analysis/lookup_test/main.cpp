@@ -0,0 +1,198 @@
+// Checks the indexed lookups of the analysis against the linear scans they replaced:
+// the source lines of every instruction from the LineTable against Symtab::getSourceLines,
+// and the loops, backedges and loop headers of every block from the loop bitsets against
+// searching the block names of each loop.
+// Run it on the binaries of sample_inputs/compile.sh, e.g.
+//   ./LookupTest ../../sample_inputs/bin/bubble-O0 ../../sample_inputs/bin/eg1-O3
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include <CodeObject.h>
+#include <Symtab.h>
+
+#include <dyninst_wrapper.hpp>
+#include <line_table.hpp>
+
+using std::vector, std::string, std::cout, std::endl, std::make_unique, std::unordered_map;
+
+namespace ParseAPI = Dyninst::ParseAPI;
+namespace SymtabAPI = Dyninst::SymtabAPI;
+
+// The block ids of the analysis: a running number over the blocks of every
+// function, in CodeObject::funcs() order. Reference blocks are named "B<id>".
+using BlockIds = unordered_map<const ParseAPI::Block *, int>;
+
+int blockId(const string &name) { return std::stoi(name.substr(name.find_last_of('B') + 1)); }
+
+LoopEntry referenceLoopEntry(const BlockIds &ids, ParseAPI::LoopTreeNode &lt) {
+  auto loop_entry = LoopEntry();
+  if (lt.loop) {
+    auto backedges = vector<ParseAPI::Edge *>();
+    auto blocks = vector<ParseAPI::Block *>();
+    auto entries = vector<ParseAPI::Block *>();
+    lt.loop->getBackEdges(backedges);
+    lt.loop->getLoopBasicBlocks(blocks);
+    lt.loop->getLoopEntries(entries);
+    loop_entry.name = lt.name();
+    loop_entry.header_block = entries.empty() ? "" : "B" + std::to_string(ids.at(entries[0]));
+    for (auto &e : backedges)
+      loop_entry.backedges.emplace_back("B" + std::to_string(ids.at(e->src())), "B" + std::to_string(ids.at(e->trg())));
+    for (auto &block : blocks) loop_entry.blocks.push_back("B" + std::to_string(ids.at(block)));
+  }
+  for (auto &i : lt.children) loop_entry.loops.push_back(referenceLoopEntry(ids, *i));
+  return loop_entry;
+}
+
+// The linear scan over the block names of each loop, as the analysis did before the bitsets
+void referenceAddLoopsToBlocks(vector<BlockInfo> &blocks, const LoopEntry &loop, unordered_map<string, int> &loop_count) {
+  for (auto &block : blocks) {
+    if (std::find(loop.blocks.begin(), loop.blocks.end(), block.name) == loop.blocks.end()) continue;
+    auto innerLoopIt = loop.loops.begin();
+    for (; innerLoopIt != loop.loops.end(); innerLoopIt++)
+      if (std::find(innerLoopIt->blocks.begin(), innerLoopIt->blocks.end(), block.name) != innerLoopIt->blocks.end()) break;
+    if (innerLoopIt == loop.loops.end()) loop_count[loop.name]++;
+    block.loops.push_back({loop.name, loop_count[loop.name], -1});
+    for (const auto &backedge : loop.backedges)
+      if (backedge.first == block.name) block.backedges.push_back(backedge.second);
+  }
+  for (const auto &innerLoop : loop.loops) referenceAddLoopsToBlocks(blocks, innerLoop, loop_count);
+}
+
+bool referenceIsLoopHeader(const string &block, const vector<LoopEntry> &loops) {
+  for (const auto &loop : loops)
+    if (loop.header_block == block || referenceIsLoopHeader(block, loop.loops)) return true;
+  return false;
+}
+
+// The blocks of every function with their loops, by block id
+unordered_map<int, BlockInfo> referenceLoopBlocks(const ParseAPI::CodeObject::funclist &funcs) {
+  auto ids = vector<BlockIds>();
+  auto curr_block_id = 0;
+  for (const auto &f : funcs) {
+    ids.emplace_back();
+    for (const auto &block : f->blocks()) ids.back()[block] = curr_block_id++;
+  }
+
+  auto result = unordered_map<int, BlockInfo>();
+  auto funcIndex = size_t(0);
+  for (const auto &f : funcs) {
+    const auto &funcIds = ids[funcIndex++];
+    auto funcLoops = vector<LoopEntry>();
+    auto lt = std::unique_ptr<ParseAPI::LoopTreeNode>(f->getLoopTree());
+    if (lt) funcLoops = referenceLoopEntry(funcIds, *lt).loops;
+
+    auto funcBlocks = vector<BlockInfo>();
+    for (const auto &block : f->blocks()) {
+      auto blockInfo = BlockInfo{"B" + std::to_string(funcIds.at(block))};
+      blockInfo.isLoopHeader = referenceIsLoopHeader(blockInfo.name, funcLoops);
+      funcBlocks.push_back(std::move(blockInfo));
+    }
+    for (const auto &loop : funcLoops) {
+      auto loop_count = unordered_map<string, int>();
+      referenceAddLoopsToBlocks(funcBlocks, loop, loop_count);
+      for (auto &block : funcBlocks)
+        for (auto &blockLoop : block.loops)
+          if (loop_count.find(blockLoop.name) != loop_count.end()) blockLoop.loopTotal = loop_count[blockLoop.name];
+    }
+    for (auto &block : funcBlocks) result.emplace(blockId(block.name), std::move(block));
+  }
+  return result;
+}
+
+bool checkLoops(const string &name, const vector<BlockInfo> &blocks, const unordered_map<int, BlockInfo> &reference) {
+  auto loopState = [](const vector<BlockLoopState> &loops) {
+    auto states = vector<std::tuple<string, int, int>>();
+    for (const auto &l : loops) states.emplace_back(l.name, l.loopCount, l.loopTotal);
+    return states;
+  };
+  auto backedgeIds = [](const vector<string> &backedges) {
+    auto result = vector<int>();
+    for (const auto &b : backedges) result.push_back(blockId(b));
+    return result;
+  };
+
+  for (const auto &block : blocks) {
+    auto expected = reference.find(blockId(block.name));
+    if (expected == reference.end()) {
+      cout << name << ": " << block.name << " is not a block of the binary" << endl;
+      return false;
+    }
+    if (loopState(expected->second.loops) != loopState(block.loops)) {
+      cout << name << ": " << block.name << " is in other loops" << endl;
+      return false;
+    }
+    if (backedgeIds(expected->second.backedges) != backedgeIds(block.backedges)) {
+      cout << name << ": " << block.name << " has other backedges" << endl;
+      return false;
+    }
+    if (expected->second.isLoopHeader != block.isLoopHeader) {
+      cout << name << ": " << block.name << (block.isLoopHeader ? " is" : " is not") << " a loop header" << endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+bool checkLines(SymtabAPI::Symtab *symtab, const vector<BlockInfo> &blocks) {
+  const auto lineTable = LineTable(symtab);
+  for (const auto &block : blocks) {
+    for (const auto &instr : block.instructions) {
+      auto statements = vector<SymtabAPI::Statement::Ptr>();
+      symtab->getSourceLines(statements, instr.address);
+      auto expected = vector<std::pair<string, int>>();
+      for (const auto &statement : statements) expected.emplace_back(statement->getFile(), statement->getLine());
+      auto actual = vector<std::pair<string, int>>();
+      for (const auto &line : lineTable.at(instr.address)) actual.emplace_back(*line.file, line.line);
+      std::sort(expected.begin(), expected.end());
+      std::sort(actual.begin(), actual.end());
+      if (expected != actual) {
+        cout << "lines: 0x" << std::hex << instr.address << std::dec << " has " << actual.size()
+             << " source lines, expected " << expected.size() << endl;
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    cout << "Usage: " << argv[0] << " <binary>..." << endl;
+    return 1;
+  }
+
+  auto failed = false;
+  for (int i = 1; i < argc; i++) {
+    const auto binaryPath = string(argv[i]);
+    // The analysis closes its Symtab when done, which openFile would share with this one
+    const auto res = decodeBinaryCache(binaryPath, false);
+    if (!res) {
+      cout << binaryPath << ": analysis failed" << endl;
+      failed = true;
+      continue;
+    }
+
+    SymtabAPI::Symtab *symtab;
+    if (!SymtabAPI::Symtab::openFile(symtab, binaryPath)) {
+      cout << binaryPath << ": can not be opened" << endl;
+      failed = true;
+      continue;
+    }
+    auto sts = make_unique<ParseAPI::SymtabCodeSource>(const_cast<char *>(binaryPath.c_str()));
+    auto co = make_unique<ParseAPI::CodeObject>(sts.get());
+    co->parse();
+
+    const auto reference = referenceLoopBlocks(co->funcs());
+    auto ok = checkLines(symtab, res->disassembly.memory_order_blocks);
+    ok &= checkLoops("memory_order", res->disassembly.memory_order_blocks, reference);
+    ok &= checkLoops("loop_order", res->disassembly.loop_order_blocks, reference);
+    cout << (ok ? "OK " : "FAILED ") << binaryPath << endl;
+    failed |= !ok;
+  }
+  return failed ? 1 : 0;
+}
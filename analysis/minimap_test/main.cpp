@@ -0,0 +1,134 @@
+// Checks the minimaps built from the block summaries against the minimaps built
+// from the instructions of every block, as they were before the summaries.
+// Run it on the binaries of sample_inputs/compile.sh, e.g.
+//   ./MinimapTest ../../sample_inputs/bin/bubble-O0 ../../sample_inputs/bin/eg1-O3
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <dyninst_wrapper.hpp>
+
+using std::vector, std::string, std::cout, std::endl;
+
+// Indexed by INSTRUCTION_FLAGS, with the names the minimap has always used
+const char *blockTypeNames[] = {"vectorized", "call", "syscall", "memory_read", "memory_write", "fp"};
+
+bool isBuiltIn(const BlockInfo &b) {
+  for (const auto &ins : b.instructions)
+    for (const auto &correspondence : ins.correspondence)
+      if (correspondence.first.size() > 5 && correspondence.first.starts_with("/usr/")) return true;
+  return false;
+}
+
+InstructionFlags blockFlags(const BlockInfo &b) {
+  auto flags = InstructionFlags();
+  for (const auto &ins : b.instructions) flags |= ins.flags;
+  return flags;
+}
+
+MinimapInfo referenceMinimap(const vector<BlockInfo> &blocks) {
+  auto minimap = MinimapInfo();
+  for (const auto &b : blocks) {
+    minimap.block_heights.push_back(b.block_type == BlockInfo::BLOCK_TYPE_NORMAL ? b.nInstructions : 0);
+    minimap.built_in_blocks.push_back(isBuiltIn(b));
+    minimap.block_start_address.push_back(b.startAddress);
+    minimap.block_loop_indents.push_back(b.loops.size());
+    auto types = vector<string>();
+    const auto flags = blockFlags(b);
+    for (int flag = INST_VECTORIZED; flag <= INST_FP; flag++)
+      if (flags.contains(INSTRUCTION_FLAGS(flag))) types.push_back(blockTypeNames[flag]);
+    minimap.block_types.push_back(types);
+  }
+  return minimap;
+}
+
+// Each bucket of a level straight from the blocks it covers. Pseudo blocks only
+// add their start address and loop depth.
+MinimapLevel referenceLevel(const vector<BlockInfo> &blocks, const int bucketBlocks) {
+  auto level = MinimapLevel{bucketBlocks};
+  for (size_t first = 0; first < blocks.size(); first += bucketBlocks) {
+    auto instructions = 0, builtIn = 0, depth = 0, bits = 0;
+    auto counts = InstructionFlagCounts{};
+    for (auto k = first; k < std::min(blocks.size(), first + bucketBlocks); k++) {
+      const auto &b = blocks[k];
+      depth = std::max(depth, (int)b.loops.size());
+      if (b.block_type != BlockInfo::BLOCK_TYPE_NORMAL) continue;
+      instructions += b.nInstructions;
+      builtIn += isBuiltIn(b);
+      bits |= blockFlags(b).bits;
+      for (const auto &ins : b.instructions)
+        for (int flag = INST_VECTORIZED; flag <= INST_FP; flag++) counts[flag] += ins.flags.contains(INSTRUCTION_FLAGS(flag));
+    }
+    auto dominant = std::max_element(counts.begin(), counts.end());
+    level.start_address.push_back(blocks[first].startAddress);
+    level.instructions.push_back(instructions);
+    level.built_in_blocks.push_back(builtIn);
+    level.loop_depth.push_back(depth);
+    level.type_bits.push_back(bits);
+    level.dominant_type.push_back(*dominant > 0 ? int(dominant - counts.begin()) : -1);
+  }
+  return level;
+}
+
+template <typename T>
+bool same(const string &what, const vector<T> &expected, const vector<T> &actual) {
+  if (expected.size() != actual.size()) {
+    cout << what << ": " << actual.size() << " entries, expected " << expected.size() << endl;
+    return false;
+  }
+  auto mismatch = std::mismatch(expected.begin(), expected.end(), actual.begin());
+  if (mismatch.first == expected.end()) return true;
+  cout << what << ": first difference at " << (mismatch.first - expected.begin()) << endl;
+  return false;
+}
+
+bool checkOrder(const string &name, const vector<BlockInfo> &blocks, const MinimapInfo &minimap, const vector<MinimapLevel> &levels) {
+  auto ok = true;
+  const auto expected = referenceMinimap(blocks);
+  ok &= same(name + " block_heights", expected.block_heights, minimap.block_heights);
+  ok &= same(name + " built_in_blocks", expected.built_in_blocks, minimap.built_in_blocks);
+  ok &= same(name + " block_start_address", expected.block_start_address, minimap.block_start_address);
+  ok &= same(name + " block_loop_indents", expected.block_loop_indents, minimap.block_loop_indents);
+  ok &= same(name + " block_types", expected.block_types, minimap.block_types);
+
+  if (blocks.empty() != levels.empty() || (!levels.empty() && levels.back().start_address.size() != 1)) {
+    cout << name << ": the levels do not end in a single bucket" << endl;
+    return false;
+  }
+  for (size_t l = 0; l < levels.size(); l++) {
+    const auto &level = levels[l];
+    const auto expectedLevel = referenceLevel(blocks, level.bucket_blocks);
+    const auto prefix = name + " level " + std::to_string(l) + " ";
+    ok &= same(prefix + "start_address", expectedLevel.start_address, level.start_address);
+    ok &= same(prefix + "instructions", expectedLevel.instructions, level.instructions);
+    ok &= same(prefix + "built_in_blocks", expectedLevel.built_in_blocks, level.built_in_blocks);
+    ok &= same(prefix + "loop_depth", expectedLevel.loop_depth, level.loop_depth);
+    ok &= same(prefix + "type_bits", expectedLevel.type_bits, level.type_bits);
+    ok &= same(prefix + "dominant_type", expectedLevel.dominant_type, level.dominant_type);
+  }
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    cout << "Usage: " << argv[0] << " <binary>..." << endl;
+    return 1;
+  }
+
+  auto failed = false;
+  for (int i = 1; i < argc; i++) {
+    const auto binaryPath = string(argv[i]);
+    const auto res = decodeBinaryCache(binaryPath, false);
+    if (!res) {
+      cout << binaryPath << ": analysis failed" << endl;
+      failed = true;
+      continue;
+    }
+    auto ok = checkOrder("memory_order", res->disassembly.memory_order_blocks, res->minimap.memory_order, res->minimap_levels.memory_order);
+    ok &= checkOrder("loop_order", res->disassembly.loop_order_blocks, res->minimap.loop_order, res->minimap_levels.loop_order);
+    cout << (ok ? "OK " : "FAILED ") << binaryPath << endl;
+    failed |= !ok;
+  }
+  return failed ? 1 : 0;
+}
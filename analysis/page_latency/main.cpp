@@ -0,0 +1,76 @@
+// Times serializing the full 100-block pages of a binary through a JSON DOM of every block, as
+// pages were before the cached block fragments, against splicing the fragments: on the first
+// request of a page, which fills its fragments, and on later requests, which only splice them.
+// Run it on a large binary, e.g.
+//   ./PageLatency ../../sample_inputs/bin/eg1-O3
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <dyninst_wrapper.hpp>
+#include <json_converter.hpp>
+
+using std::vector, std::string, std::cout, std::endl;
+
+#define ROUNDS 20
+
+using Clock = std::chrono::steady_clock;
+
+double microseconds(const Clock::duration duration) { return std::chrono::duration<double, std::micro>(duration).count(); }
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    cout << "Usage: " << argv[0] << " <binary>..." << endl;
+    return 1;
+  }
+
+  auto failed = false;
+  for (int i = 1; i < argc; i++) {
+    const auto binaryPath = string(argv[i]);
+    for (const auto order : {MEMORY_ORDER, LOOP_ORDER}) {
+      auto dom = Clock::duration(), firstRequest = Clock::duration(), laterRequest = Clock::duration();
+      auto pages = 0;
+      auto page = DisassemblyPage();
+      for (int pageNo = 0; getDisassemblyPage(binaryPath, false, order, pageNo, page) && page.blocks.size() == BLOCKS_PER_PAGE; pageNo++) {
+        auto expected = string();
+        for (int round = 0; round < ROUNDS; round++) {
+          const auto start = Clock::now();
+          expected = convertDisassemblyPage(page).dump();
+          dom += Clock::now() - start;
+        }
+
+        // The same page with fragments of its own, emptied for every first request
+        auto fragments = vector<string>(page.blocks.size());
+        auto fragmentPage = DisassemblyPage{page.blocks, fragments, {}, page.pageNo, page.isLast};
+        auto body = string();
+        for (int round = 0; round < ROUNDS; round++) {
+          for (auto &fragment : fragments) string().swap(fragment);
+          const auto start = Clock::now();
+          body = serializeDisassemblyPage(fragmentPage);
+          firstRequest += Clock::now() - start;
+        }
+        for (int round = 0; round < ROUNDS; round++) {
+          const auto start = Clock::now();
+          body = serializeDisassemblyPage(fragmentPage);
+          laterRequest += Clock::now() - start;
+        }
+        if (body != expected) {
+          cout << "FAILED " << binaryPath << ": page " << pageNo << " differs from its DOM" << endl;
+          failed = true;
+          break;
+        }
+        pages++;
+        if (page.isLast) break;
+      }
+      if (pages == 0) continue;
+
+      const auto requests = double(pages) * ROUNDS;
+      cout << binaryPath << " " << (order == MEMORY_ORDER ? "memory_order" : "loop_order") << ", " << pages
+           << " pages of " << BLOCKS_PER_PAGE << " blocks, microseconds per page: DOM " << microseconds(dom) / requests
+           << ", fragments on the first request " << microseconds(firstRequest) / requests << ", on later requests "
+           << microseconds(laterRequest) / requests << endl;
+    }
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,85 @@
+// Compares print_clean_string and number_to_hex with the regex and stringstream code they
+// replaced: checks that both give the same strings, then times each on the same inputs.
+//   ./StringBench
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using std::vector, std::string, std::cout, std::endl;
+
+// Defined in dyninst_wrapper.cpp
+string print_clean_string(string str);
+string number_to_hex(const unsigned long val);
+
+#define CHECKED_STRINGS 20000
+#define TIMED_STRINGS 200000
+#define CHECKED_NUMBERS 100000
+#define TIMED_NUMBERS 200000
+
+string referenceCleanString(const string &str) {
+  static std::regex pattern("[^a-zA-Z0-9 /:;,\\.{}\\[\\]<>~|\\-_+()&\\*=$!#]");
+  return regex_replace(str, pattern, "?");
+}
+
+string referenceHex(const unsigned long val) {
+  auto stream = std::stringstream();
+  stream << std::nouppercase << std::showbase << std::hex << val;
+  return stream.str();
+}
+
+// Milliseconds of calling f on every input, summing the lengths so the calls are kept
+template <typename Input, typename F>
+double timeMs(const vector<Input> &inputs, const size_t calls, F f) {
+  auto length = size_t(0);
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < calls; i++) length += f(inputs[i % inputs.size()]).size();
+  const auto end = std::chrono::steady_clock::now();
+  if (length == 0) cout << "no output" << endl;
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main() {
+  auto random = std::mt19937(0);
+
+  // Random bytes, and names like the ones of functions and blocks
+  auto strings = vector<string>();
+  for (int i = 0; i < CHECKED_STRINGS / 2; i++) {
+    auto str = string(1 + random() % 64, ' ');
+    for (auto &c : str) c = char(random() % 256);
+    strings.push_back(std::move(str));
+  }
+  for (int i = 0; i < CHECKED_STRINGS / 2; i++)
+    strings.push_back("std::vector<int, std::allocator<int> >::_M_realloc_insert#B" + std::to_string(random() % 100000));
+
+  // Numbers of every width, up to full 64-bit values
+  auto numbers = vector<unsigned long>{0};
+  for (int i = 1; i < CHECKED_NUMBERS; i++) numbers.push_back(((unsigned long)random() << 32 | random()) >> (random() % 64));
+
+  auto failed = false;
+  for (const auto &str : strings) {
+    if (print_clean_string(str) != referenceCleanString(str)) {
+      cout << "FAILED print_clean_string differs on \"" << referenceCleanString(str) << "\"" << endl;
+      failed = true;
+      break;
+    }
+  }
+  for (const auto number : numbers) {
+    if (number_to_hex(number) != referenceHex(number)) {
+      cout << "FAILED number_to_hex(" << number << ") is " << number_to_hex(number) << ", expected " << referenceHex(number) << endl;
+      failed = true;
+      break;
+    }
+  }
+  if (failed) return 1;
+  cout << "OK " << strings.size() << " strings and " << numbers.size() << " numbers match" << endl;
+
+  cout << TIMED_STRINGS << " strings: regex " << timeMs(strings, TIMED_STRINGS, referenceCleanString) << " ms, table "
+       << timeMs(strings, TIMED_STRINGS, [](const string &str) { return print_clean_string(str); }) << " ms" << endl;
+  cout << TIMED_NUMBERS << " numbers: stringstream " << timeMs(numbers, TIMED_NUMBERS, referenceHex) << " ms, to_chars "
+       << timeMs(numbers, TIMED_NUMBERS, [](const unsigned long number) { return number_to_hex(number); }) << " ms" << endl;
+  return 0;
+}
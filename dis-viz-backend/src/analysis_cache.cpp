@@ -0,0 +1,446 @@
+#include <analysis_cache.hpp>
+#include <mapped_file.hpp>
+
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+using std::string, std::string_view, std::vector, std::map, std::unordered_map;
+
+// Cache file layout, all integers little endian:
+//   magic[8] | version u32 | reserved u32 | binary hash u64
+//   string table: count, then (length, bytes) per string
+//   body: the BinaryCacheResult, strings as string table indices
+// Everything after the header is LEB128 varints (zigzag for signed values).
+
+static const char CACHE_MAGIC[8] = {'D', 'I', 'S', 'V', 'I', 'Z', 'C', '\0'};
+static const size_t CACHE_HEADER_SIZE = 24;
+
+class CacheWriter {
+ public:
+  void u(uint64_t val) {
+    while (val >= 0x80) {
+      bytes.push_back(char(val | 0x80));
+      val >>= 7;
+    }
+    bytes.push_back(char(val));
+  }
+  void i(const int64_t val) { u((uint64_t(val) << 1) ^ uint64_t(val >> 63)); }
+  void b(const bool val) { u(val ? 1 : 0); }
+  void str(const string &val) {
+    auto [it, inserted] = stringIds.try_emplace(val, strings.size());
+    if (inserted) strings.push_back(&it->first);
+    u(it->second);
+  }
+
+  string finish(const uint64_t binaryHash) {
+    auto body = std::move(bytes);
+    bytes.clear();
+    for (int k = 0; k < 8; k++) bytes.push_back(CACHE_MAGIC[k]);
+    fixed(ANALYSIS_CACHE_VERSION, 4);
+    fixed(0, 4);
+    fixed(binaryHash, 8);
+    u(strings.size());
+    for (const auto s : strings) {
+      u(s->size());
+      bytes.append(*s);
+    }
+    bytes.append(body);
+    return std::move(bytes);
+  }
+
+ private:
+  void fixed(const uint64_t val, const int width) {
+    for (int k = 0; k < width; k++) bytes.push_back(char(val >> (8 * k)));
+  }
+
+  string bytes;
+  unordered_map<string, uint32_t> stringIds;
+  vector<const string *> strings;
+};
+
+class CacheReader {
+ public:
+  CacheReader(const uint8_t *begin, const uint8_t *end) : cur(begin), end(end) {}
+
+  uint64_t u() {
+    auto val = uint64_t(0);
+    for (int shift = 0; shift < 64; shift += 7) {
+      if (cur == end) throw std::runtime_error("truncated analysis cache");
+      auto byte = *cur++;
+      val |= uint64_t(byte & 0x7f) << shift;
+      if (!(byte & 0x80)) return val;
+    }
+    throw std::runtime_error("malformed varint in analysis cache");
+  }
+  int64_t i() {
+    auto val = u();
+    return int64_t(val >> 1) ^ -int64_t(val & 1);
+  }
+  bool b() { return u() != 0; }
+  // The length of a list whose items take at least one byte each. It is checked
+  // against the rest of the file before anything is allocated for the list.
+  uint64_t count() {
+    auto n = u();
+    if (n > uint64_t(end - cur)) throw std::runtime_error("bad count in analysis cache");
+    return n;
+  }
+  string str() {
+    auto id = u();
+    if (id >= strings.size()) throw std::runtime_error("bad string index in analysis cache");
+    return string(strings[id]);
+  }
+  uint64_t fixed(const int width) {
+    if (end - cur < width) throw std::runtime_error("truncated analysis cache");
+    auto val = uint64_t(0);
+    for (int k = 0; k < width; k++) val |= uint64_t(cur[k]) << (8 * k);
+    cur += width;
+    return val;
+  }
+  void readStrings() {
+    auto n = count();
+    strings.reserve(n);
+    for (uint64_t k = 0; k < n; k++) {
+      auto len = u();
+      if (uint64_t(end - cur) < len) throw std::runtime_error("truncated analysis cache");
+      strings.emplace_back(reinterpret_cast<const char *>(cur), len);
+      cur += len;
+    }
+  }
+  bool done() const { return cur == end; }
+
+ private:
+  const uint8_t *cur;
+  const uint8_t *end;
+  vector<string_view> strings;  // views into the mapped file
+};
+
+// Serializers, one write/read pair per cached type
+
+void write(CacheWriter &w, const string &s) { w.str(s); }
+void read(CacheReader &r, string &s) { s = r.str(); }
+void write(CacheWriter &w, const int val) { w.i(val); }
+void read(CacheReader &r, int &val) { val = r.i(); }
+void write(CacheWriter &w, const unsigned long val) { w.u(val); }
+void read(CacheReader &r, unsigned long &val) { val = r.u(); }
+
+template <typename T>
+void write(CacheWriter &w, const vector<T> &list) {
+  w.u(list.size());
+  for (const auto &item : list) write(w, item);
+}
+template <typename T>
+void read(CacheReader &r, vector<T> &list) {
+  list.resize(r.count());
+  for (auto &item : list) read(r, item);
+}
+
+void write(CacheWriter &w, const VarLocation &location) {
+  w.u(location.start);
+  w.u(location.end);
+  w.str(location.location);
+}
+void read(CacheReader &r, VarLocation &location) {
+  location.start = r.u();
+  location.end = r.u();
+  location.location = r.str();
+}
+
+void write(CacheWriter &w, const VariableInfo &var) {
+  w.str(var.name);
+  w.str(var.file);
+  w.i(var.line);
+  write(w, var.locations);
+  w.u(var.var_type);
+}
+void read(CacheReader &r, VariableInfo &var) {
+  var.name = r.str();
+  var.file = r.str();
+  var.line = r.i();
+  read(r, var.locations);
+  var.var_type = decltype(var.var_type)(r.u());
+}
+
+void write(CacheWriter &w, const BlockLoopState &loop) {
+  w.str(loop.name);
+  w.i(loop.loopCount);
+  w.i(loop.loopTotal);
+}
+void read(CacheReader &r, BlockLoopState &loop) {
+  loop.name = r.str();
+  loop.loopCount = r.i();
+  loop.loopTotal = r.i();
+}
+
+void write(CacheWriter &w, const Hidable &hidable) {
+  w.str(hidable.name);
+  w.u(hidable.start);
+  w.u(hidable.end);
+}
+void read(CacheReader &r, Hidable &hidable) {
+  hidable.name = r.str();
+  hidable.start = r.u();
+  hidable.end = r.u();
+}
+
+void writeInstruction(CacheWriter &w, const InstructionInfo &instruction, unsigned long &prevAddress) {
+  w.i(int64_t(instruction.address - prevAddress));
+  prevAddress = instruction.address;
+  w.str(instruction.instruction);
+  w.u(instruction.correspondence.size());
+  for (const auto &[file, lines] : instruction.correspondence) {
+    w.str(file);
+    write(w, lines);
+  }
+  write(w, instruction.variables);
+  w.u(instruction.flags.bits);
+}
+void readInstruction(CacheReader &r, InstructionInfo &instruction, unsigned long &prevAddress) {
+  instruction.address = prevAddress + r.i();
+  prevAddress = instruction.address;
+  instruction.instruction = r.str();
+  auto nFiles = r.u();
+  for (uint64_t k = 0; k < nFiles; k++) {
+    auto file = r.str();
+    read(r, instruction.correspondence[file]);
+  }
+  read(r, instruction.variables);
+  instruction.flags.bits = uint8_t(r.u());
+}
+
+void write(CacheWriter &w, const BlockInfo &block) {
+  w.str(block.name);
+  w.u(block.instructions.size());
+  auto prevAddress = 0ul;
+  for (const auto &instruction : block.instructions) writeInstruction(w, instruction, prevAddress);
+  w.str(block.functionName);
+  write(w, block.nextBlockNames);
+  write(w, block.loops);
+  w.b(block.isLoopHeader);
+  w.u(block.block_type);
+  write(w, block.backedges);
+  write(w, block.hidables);
+  w.i(block.startAddress);
+  w.i(block.endAddress);
+  w.i(block.nInstructions);
+  w.u(block.flags.bits);
+  for (const auto count : block.flagCounts) w.u(count);
+  w.b(block.builtIn);
+}
+void read(CacheReader &r, BlockInfo &block) {
+  block.name = r.str();
+  block.instructions.resize(r.count());
+  auto prevAddress = 0ul;
+  for (auto &instruction : block.instructions) readInstruction(r, instruction, prevAddress);
+  block.functionName = r.str();
+  read(r, block.nextBlockNames);
+  read(r, block.loops);
+  block.isLoopHeader = r.b();
+  block.block_type = decltype(block.block_type)(r.u());
+  read(r, block.backedges);
+  read(r, block.hidables);
+  block.startAddress = r.i();
+  block.endAddress = r.i();
+  block.nInstructions = r.i();
+  block.flags.bits = uint8_t(r.u());
+  for (auto &count : block.flagCounts) count = int(r.u());
+  block.builtIn = r.b();
+}
+
+void write(CacheWriter &w, const MinimapInfo &minimap) {
+  write(w, minimap.block_heights);
+  w.u(minimap.built_in_blocks.size());
+  for (const auto builtIn : minimap.built_in_blocks) w.b(builtIn);
+  write(w, minimap.block_start_address);
+  write(w, minimap.block_loop_indents);
+  write(w, minimap.block_types);
+}
+// A minimap is indexed by the positions of its order, so it must have an entry per block
+void read(CacheReader &r, MinimapInfo &minimap, const size_t nBlocks) {
+  read(r, minimap.block_heights);
+  minimap.built_in_blocks.resize(r.count());
+  for (size_t k = 0; k < minimap.built_in_blocks.size(); k++) minimap.built_in_blocks[k] = r.b();
+  read(r, minimap.block_start_address);
+  read(r, minimap.block_loop_indents);
+  read(r, minimap.block_types);
+  if (minimap.block_heights.size() != nBlocks || minimap.built_in_blocks.size() != nBlocks ||
+      minimap.block_start_address.size() != nBlocks || minimap.block_loop_indents.size() != nBlocks ||
+      minimap.block_types.size() != nBlocks)
+    throw std::runtime_error("minimap does not match the blocks in analysis cache");
+}
+
+// Loop order blocks are copies of memory order blocks, so they are stored as
+// references into the memory order whenever a block with the same name and
+// type exists there.
+void writeLoopOrder(CacheWriter &w, const vector<BlockInfo> &memoryOrder, const vector<BlockInfo> &loopOrder) {
+  auto index = unordered_map<string, size_t>();
+  for (size_t k = 0; k < memoryOrder.size(); k++)
+    index.try_emplace(memoryOrder[k].name + char('0' + memoryOrder[k].block_type), k);
+
+  w.u(loopOrder.size());
+  for (const auto &block : loopOrder) {
+    auto found = index.find(block.name + char('0' + block.block_type));
+    if (found != index.end()) {
+      w.u(0);
+      w.u(found->second);
+    } else {
+      w.u(1);
+      write(w, block);
+    }
+  }
+}
+void readLoopOrder(CacheReader &r, const vector<BlockInfo> &memoryOrder, vector<BlockInfo> &loopOrder) {
+  loopOrder.resize(r.count());
+  for (auto &block : loopOrder) {
+    if (r.u() == 0) {
+      auto k = r.u();
+      if (k >= memoryOrder.size()) throw std::runtime_error("bad block index in analysis cache");
+      block = memoryOrder[k];
+    } else {
+      read(r, block);
+    }
+  }
+}
+
+void write(CacheWriter &w, const BinaryCacheResult &res) {
+  write(w, res.disassembly.memory_order_blocks);
+  writeLoopOrder(w, res.disassembly.memory_order_blocks, res.disassembly.loop_order_blocks);
+  write(w, res.minimap.memory_order);
+  write(w, res.minimap.loop_order);
+  write(w, res.source_files);
+
+  w.u(res.correspondences.size());
+  for (const auto &[file, lines] : res.correspondences) {
+    w.str(file);
+    w.u(lines.size());
+    for (const auto &[line, addresses] : lines) {
+      w.i(line);
+      write(w, addresses);
+    }
+  }
+
+  w.u(res.sourceCodeInfo.size());
+  for (const auto &[file, lines] : res.sourceCodeInfo) {
+    w.str(file);
+    w.u(lines.size());
+    for (const auto &[line, tags] : lines) {
+      w.i(line);
+      w.u(tags.size());
+      for (const auto tag : tags) w.u(tag);
+    }
+  }
+}
+void read(CacheReader &r, BinaryCacheResult &res) {
+  read(r, res.disassembly.memory_order_blocks);
+  readLoopOrder(r, res.disassembly.memory_order_blocks, res.disassembly.loop_order_blocks);
+  read(r, res.minimap.memory_order, res.disassembly.memory_order_blocks.size());
+  read(r, res.minimap.loop_order, res.disassembly.loop_order_blocks.size());
+  read(r, res.source_files);
+
+  auto nFiles = r.u();
+  for (uint64_t k = 0; k < nFiles; k++) {
+    auto &lines = res.correspondences[r.str()];
+    auto nLines = r.u();
+    for (uint64_t l = 0; l < nLines; l++) {
+      auto line = int(r.i());
+      read(r, lines[line]);
+    }
+  }
+
+  nFiles = r.u();
+  for (uint64_t k = 0; k < nFiles; k++) {
+    auto &lines = res.sourceCodeInfo[r.str()];
+    auto nLines = r.u();
+    for (uint64_t l = 0; l < nLines; l++) {
+      auto &tags = lines[int(r.i())];
+      auto nTags = r.u();
+      for (uint64_t t = 0; t < nTags; t++) tags.insert(SourceCodeTags(r.u()));
+    }
+  }
+}
+
+std::filesystem::path cacheFilePath(const string &cacheDir, const uint64_t binaryHash) {
+  char name[32];
+  snprintf(name, sizeof(name), "%016lx.dvc", (unsigned long)binaryHash);
+  return std::filesystem::path(cacheDir) / name;
+}
+
+// 64-bit FNV-1a over 8-byte words, finished with a murmur-style mix. Only
+// used to tell binaries apart, not as a cryptographic digest.
+uint64_t hashBinaryContents(const string &binaryPath) {
+  auto file = MappedFile(binaryPath);
+  if (!file.valid()) return 0;
+
+  auto hash = 0xcbf29ce484222325ull ^ file.size();
+  auto data = file.data();
+  auto n = file.size();
+  size_t k = 0;
+  for (; k + 8 <= n; k += 8) {
+    auto word = uint64_t();
+    memcpy(&word, data + k, 8);
+    hash = (hash ^ word) * 0x100000001b3ull;
+  }
+  for (; k < n; k++) hash = (hash ^ data[k]) * 0x100000001b3ull;
+
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdull;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ull;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+bool loadAnalysisCache(const string &cacheDir, const uint64_t binaryHash, BinaryCacheResult &result) {
+  auto path = cacheFilePath(cacheDir, binaryHash);
+  auto file = MappedFile(path.string());
+  if (!file.valid() || file.size() < CACHE_HEADER_SIZE) return false;
+  if (memcmp(file.data(), CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0) return false;
+
+  try {
+    auto r = CacheReader(file.data() + sizeof(CACHE_MAGIC), file.data() + file.size());
+    if (r.fixed(4) != ANALYSIS_CACHE_VERSION) return false;
+    r.fixed(4);
+    if (r.fixed(8) != binaryHash) return false;
+    r.readStrings();
+    auto loaded = BinaryCacheResult();
+    read(r, loaded);
+    if (!r.done()) return false;
+    result = std::move(loaded);
+    return true;
+  } catch (const std::exception &e) {
+    std::cerr << "Warning: ignoring analysis cache " << path << ": " << e.what() << std::endl;
+    return false;
+  }
+}
+
+bool saveAnalysisCache(const string &cacheDir, const uint64_t binaryHash, const BinaryCacheResult &result) {
+  auto w = CacheWriter();
+  write(w, result);
+  auto bytes = w.finish(binaryHash);
+
+  auto error = std::error_code();
+  std::filesystem::create_directories(cacheDir, error);
+  auto path = cacheFilePath(cacheDir, binaryHash);
+  // Writes of the same binary by concurrent jobs, in this or another process, each get their own file
+  static auto tmpFiles = std::atomic<unsigned int>(0);
+  auto tmpPath = path;
+  tmpPath += ".tmp" + std::to_string(getpid()) + "." + std::to_string(tmpFiles++);
+  {
+    auto o = std::ofstream(tmpPath, std::ios::binary);
+    o.write(bytes.data(), bytes.size());
+    if (!o) {
+      std::cerr << "Warning: could not write analysis cache " << tmpPath << std::endl;
+      std::filesystem::remove(tmpPath, error);
+      return false;
+    }
+  }
+  // Readers only ever see a complete file
+  std::filesystem::rename(tmpPath, path, error);
+  return !error;
+}
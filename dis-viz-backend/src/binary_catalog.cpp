@@ -0,0 +1,100 @@
+#include <binary_catalog.hpp>
+
+#include <elf.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+template <typename T>
+T fromElf(const T value, const bool swap) {
+  if (!swap) return value;
+  auto bytes = std::bit_cast<std::array<unsigned char, sizeof(T)>>(value);
+  std::reverse(bytes.begin(), bytes.end());
+  return std::bit_cast<T>(bytes);
+}
+
+// Whether the object file and its section headers are well formed, which Dyninst
+// needs to read the symbols and the code
+template <typename Ehdr, typename Shdr>
+bool hasSectionHeaders(std::ifstream &ifs, const uintmax_t size, const bool swap) {
+  Ehdr header;
+  if (!ifs.seekg(0) || !ifs.read(reinterpret_cast<char *>(&header), sizeof(header))) return false;
+  const auto type = fromElf(header.e_type, swap);
+  if (type != ET_REL && type != ET_EXEC && type != ET_DYN) return false;
+  const auto shoff = uintmax_t(fromElf(header.e_shoff, swap));
+  const auto shnum = uintmax_t(fromElf(header.e_shnum, swap));
+  const auto shstrndx = uintmax_t(fromElf(header.e_shstrndx, swap));
+  if (fromElf(header.e_shentsize, swap) != sizeof(Shdr) || shnum == 0 || shstrndx >= shnum) return false;
+  if (shoff > size || shnum * sizeof(Shdr) > size - shoff) return false;
+
+  // The section names are needed to find the symbol tables and .text
+  Shdr names;
+  if (!ifs.seekg(shoff + shstrndx * sizeof(Shdr)) || !ifs.read(reinterpret_cast<char *>(&names), sizeof(names))) return false;
+  const auto offset = uintmax_t(fromElf(names.sh_offset, swap));
+  return fromElf(names.sh_type, swap) == SHT_STRTAB && offset <= size && uintmax_t(fromElf(names.sh_size, swap)) <= size - offset;
+}
+
+// Checks the ELF headers directly, which rules out sources, scripts and archives
+// after reading a few bytes. Opening the file with Dyninst would share the
+// Symtab of a binary that is being analyzed, which can not be closed safely here.
+bool isParsableElf(const fs::path &path, const uintmax_t size) {
+  unsigned char ident[EI_NIDENT];
+  auto ifs = std::ifstream(path, std::ios::binary);
+  if (!ifs.read(reinterpret_cast<char *>(ident), sizeof(ident))) return false;
+  if (std::memcmp(ident, ELFMAG, SELFMAG) != 0 || ident[EI_VERSION] != EV_CURRENT) return false;
+  if (ident[EI_DATA] != ELFDATA2LSB && ident[EI_DATA] != ELFDATA2MSB) return false;
+  const auto swap = (ident[EI_DATA] == ELFDATA2LSB) != (std::endian::native == std::endian::little);
+  if (ident[EI_CLASS] == ELFCLASS64) return hasSectionHeaders<Elf64_Ehdr, Elf64_Shdr>(ifs, size, swap);
+  if (ident[EI_CLASS] == ELFCLASS32) return hasSectionHeaders<Elf32_Ehdr, Elf32_Shdr>(ifs, size, swap);
+  return false;
+}
+
+std::vector<CatalogEntry> BinaryCatalog::list() {
+  auto lock = std::lock_guard(m);
+  const auto now = std::chrono::steady_clock::now();
+  if (!scanned || now - lastScan >= RESCAN_INTERVAL) {
+    scan();
+    lastScan = now;
+    scanned = true;
+  }
+  return entries;
+}
+
+void BinaryCatalog::scan() {
+  auto seen = std::unordered_map<std::string, Verdict>();
+  entries.clear();
+  for (const auto &binaryPath : paths) {
+    auto error = std::error_code();
+    if (fs::is_directory(binaryPath, error)) {
+      for (const auto &entry : fs::directory_iterator(binaryPath, error))
+        if (entry.is_regular_file(error)) addFile(entry.path(), seen);
+    } else {
+      addFile(binaryPath, seen);
+    }
+  }
+  // Files that disappeared are forgotten
+  verdicts = std::move(seen);
+}
+
+void BinaryCatalog::addFile(const fs::path &path, std::unordered_map<std::string, Verdict> &seen) {
+  auto sizeError = std::error_code();
+  auto timeError = std::error_code();
+  const auto size = fs::file_size(path, sizeError);
+  const auto modified = fs::last_write_time(path, timeError);
+  if (sizeError || timeError) return;
+
+  const auto key = path.string();
+  auto it = verdicts.find(key);
+  auto parsable = false;
+  if (it != verdicts.end() && it->second.size == size && it->second.modified == modified)
+    parsable = it->second.parsable;
+  else
+    parsable = isParsableElf(path, size);
+  seen[key] = Verdict{size, modified, parsable};
+  if (parsable) entries.push_back({path.filename().string(), key});
+}
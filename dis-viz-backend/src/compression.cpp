@@ -0,0 +1,64 @@
+#include <compression.hpp>
+#include <string_view>
+#include <zlib.h>
+
+// Whether acceptEncoding lists coding with a nonzero quality
+bool acceptsCoding(const std::string_view acceptEncoding, const std::string_view coding) {
+  auto rest = acceptEncoding;
+  while (!rest.empty()) {
+    auto comma = rest.find(',');
+    auto item = rest.substr(0, comma);
+    rest = comma == std::string_view::npos ? std::string_view() : rest.substr(comma + 1);
+
+    auto semicolon = item.find(';');
+    auto name = item.substr(0, semicolon);
+    while (!name.empty() && name.front() == ' ') name.remove_prefix(1);
+    while (!name.empty() && name.back() == ' ') name.remove_suffix(1);
+    if (name != coding) continue;
+
+    auto q = semicolon == std::string_view::npos ? std::string_view() : item.substr(semicolon + 1);
+    while (!q.empty() && q.front() == ' ') q.remove_prefix(1);
+    // q=0, q=0.0, ... refuse the coding
+    if (q.starts_with("q=0") && q.find_first_of("123456789") == std::string_view::npos) return false;
+    return true;
+  }
+  return false;
+}
+
+CONTENT_CODING chooseContentCoding(const std::string &acceptEncoding) {
+  if (acceptsCoding(acceptEncoding, "gzip")) return CODING_GZIP;
+  if (acceptsCoding(acceptEncoding, "deflate")) return CODING_DEFLATE;
+  return CODING_IDENTITY;
+}
+
+const char *contentCodingName(const CONTENT_CODING coding) {
+  switch (coding) {
+    case CODING_GZIP: return "gzip";
+    case CODING_DEFLATE: return "deflate";
+    default: return "identity";
+  }
+}
+
+bool compressBody(const std::string &body, const CONTENT_CODING coding, std::string &compressed) {
+  auto stream = z_stream();
+  // windowBits + 16 writes a gzip wrapper, plain windowBits the zlib format of HTTP deflate
+  auto windowBits = coding == CODING_GZIP ? MAX_WBITS + 16 : MAX_WBITS;
+  if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK) return false;
+
+  compressed.resize(deflateBound(&stream, body.size()));
+  stream.next_in = (Bytef *)body.data();
+  stream.avail_in = body.size();
+  stream.next_out = (Bytef *)compressed.data();
+  stream.avail_out = compressed.size();
+  auto status = deflate(&stream, Z_FINISH);
+  compressed.resize(stream.total_out);
+  deflateEnd(&stream);
+  return status == Z_STREAM_END;
+}
+
+EncodedBody encodeBody(std::string body, const CONTENT_CODING coding) {
+  auto compressed = std::string();
+  if (coding == CODING_IDENTITY || body.size() < MIN_COMPRESSED_SIZE || !compressBody(body, coding, compressed))
+    return {std::move(body), CODING_IDENTITY};
+  return {std::move(compressed), coding};
+}
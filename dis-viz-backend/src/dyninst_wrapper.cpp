@@ -1,10 +1,14 @@
 #include <dyninst_wrapper.hpp>
-#include <regex>
+#include <array>
+#include <charconv>
+#include <string_view>
 #include <unordered_map>
+#include <list>
 #include <map>
 #include <set>
+#include <unordered_set>
 #include <algorithm>
-#include <boost/range/adaptor/indexed.hpp>
+#include <numeric>
 #include <filesystem>
 
 #include <CodeObject.h>
@@ -13,19 +17,29 @@
 #include <Symtab.h>
 
 #include <json_converter.hpp>
+#include <analysis_cache.hpp>
+#include <line_table.hpp>
 #include <fstream>
 
 #include <indicators/progress_bar.hpp> // https://github.com/p-ranav/indicators
 #include <vector>
+#include <atomic>
+#include <condition_variable>
+#include <future>
+#include <limits>
+#include <mutex>
+#include <shared_mutex>
+#include <span>
+#include <thread>
 
-using std::set, std::vector, std::string, std::map, std::unordered_map, std::ifstream, std::stringstream, std::unique_ptr;
+using std::set, std::vector, std::string, std::map, std::unordered_map, std::ifstream, std::unique_ptr;
 
 namespace InstructionAPI = Dyninst::InstructionAPI;
 namespace ParseAPI = Dyninst::ParseAPI;
 namespace SymtabAPI = Dyninst::SymtabAPI;
 
 void setInstructionFlags(const InstructionAPI::Instruction &instr,
-                   std::unordered_set<INSTRUCTION_FLAGS> &flags) {
+                   InstructionFlags &flags) {
   switch (instr.getCategory()) {
 #if defined(DYNINST_MAJOR_VERSION) && (DYNINST_MAJOR_VERSION >= 10)
     case InstructionAPI::c_VectorInsn:
@@ -46,33 +60,54 @@ void setInstructionFlags(const InstructionAPI::Instruction &instr,
   if (instr.writesMemory()) flags.insert(INST_MEMORY_WRITE);
 }
 
-string print_clean_string(const string &str) {
-  static std::regex pattern("[^a-zA-Z0-9 /:;,\\.{}\\[\\]<>~|\\-_+()&\\*=$!#]");
-  return regex_replace(str, pattern, "?");
+// Characters print_clean_string keeps, everything else becomes '?'
+constexpr auto cleanCharacters = [] {
+  auto table = std::array<bool, 256>();
+  for (auto c = 'a'; c <= 'z'; c++) table[c] = true;
+  for (auto c = 'A'; c <= 'Z'; c++) table[c] = true;
+  for (auto c = '0'; c <= '9'; c++) table[c] = true;
+  for (auto c : std::string_view(" /:;,.{}[]<>~|-_+()&*=$!#")) table[(unsigned char)c] = true;
+  return table;
+}();
+
+void clean_string_in_place(string &str) {
+  for (auto &c : str)
+    if (!cleanCharacters[(unsigned char)c]) c = '?';
+}
+
+string print_clean_string(string str) {
+  clean_string_in_place(str);
+  return str;
+}
+
+// Writes val like std::showbase << std::hex does ("0x1f", but "0" for zero)
+// and returns the end. out needs room for 18 characters.
+char *format_hex(char *out, const unsigned long val) {
+  if (val == 0) {
+    *out++ = '0';
+    return out;
+  }
+  *out++ = '0';
+  *out++ = 'x';
+  return std::to_chars(out, out + 16, val, 16).ptr;
 }
 
 string number_to_hex(const unsigned long val) {
-  auto stream = stringstream();
-  stream << std::nouppercase << std::showbase << std::hex << (unsigned int)val;
-  return stream.str();
+  char buffer[18];
+  return string(buffer, format_hex(buffer, val));
 }
 
 string number_to_hex(const unsigned int val) {
-  auto stream = stringstream();
-  stream << std::nouppercase << std::showbase << std::hex << val;
-  return stream.str();
+  return number_to_hex((unsigned long)val);
 }
 
+// Negative values are printed in two's complement of their own width
 string number_to_hex(const int val) {
-  auto stream = stringstream();
-  stream << std::nouppercase << std::showbase << std::hex << val;
-  return stream.str();
+  return number_to_hex((unsigned long)(unsigned int)val);
 }
 
 string number_to_hex(const long val) {
-  auto stream = stringstream();
-  stream << std::nouppercase << std::showbase << std::hex << (int)val;
-  return stream.str();
+  return number_to_hex((unsigned long)val);
 }
 
 inline string getRegFromFullName(const string &fullname) {
@@ -87,11 +122,10 @@ VariableInfo printVar(SymtabAPI::localVar *var) {
   auto varLocations = vector<VarLocation>();
   auto locations = var->getLocationLists();
   for (auto &location : locations) {
-    auto frameOffset = location.frameOffset;
+    // The disassembler prints displacements at 32 bits, so -8 is 0xfffffff8
+    auto frameOffset = (int)location.frameOffset;
     auto lowPC = location.lowPC;
     auto hiPC = location.hiPC;
-    auto hiPC_str = number_to_hex(hiPC);
-    auto lowPC_str = number_to_hex(lowPC);
 
     auto mr_reg = location.mr_reg;
     auto full_regName = mr_reg.name();
@@ -125,14 +159,40 @@ VariableInfo printVar(SymtabAPI::localVar *var) {
                          ")";  // at&t syntax
       }
     }
-    varLocations.push_back({lowPC_str, hiPC_str, finalVarString});
+    varLocations.push_back({lowPC, hiPC, finalVarString});
   }
   return {print_clean_string(name), fileName, lineNum, varLocations};
 }
 
-long totalLoops = 0;
+// Block names are handed out in function order and a block shared by several
+// functions is renamed by each of them. Every assignment is kept so that a
+// function analyzed on a worker sees exactly the names the serial walk saw.
+class BlockNames {
+ public:
+  void assign(const ParseAPI::Block *block, const size_t funcIndex, string name) {
+    names[block].emplace_back(funcIndex, std::move(name));
+  }
+
+  const string *find(const ParseAPI::Block *block, const size_t funcIndex) const {
+    auto it = names.find(block);
+    if (it == names.end()) return nullptr;
+    for (auto name = it->second.rbegin(); name != it->second.rend(); name++)
+      if (name->first <= funcIndex) return &name->second;
+    return nullptr;
+  }
+
+  string at(const ParseAPI::Block *block, const size_t funcIndex) const {
+    auto name = find(block, funcIndex);
+    return name ? *name : string();
+  }
+
+ private:
+  unordered_map<const ParseAPI::Block *, vector<std::pair<size_t, string>>> names;
+};
+
+std::atomic<long> totalLoops = 0;
 
-LoopEntry printLoopEntry(map<ParseAPI::Block *, string> &block_ids, ParseAPI::LoopTreeNode &lt) {
+LoopEntry printLoopEntry(const BlockNames &block_ids, const size_t funcIndex, ParseAPI::LoopTreeNode &lt) {
   auto loop_entry = LoopEntry();
 
   if (lt.loop) {
@@ -144,7 +204,7 @@ LoopEntry printLoopEntry(map<ParseAPI::Block *, string> &block_ids, ParseAPI::Lo
     loop_entry.name = lt.name();
     std::vector<ParseAPI::Block *> loop_entry_blocks;
     lt.loop->getLoopEntries(loop_entry_blocks);
-    loop_entry.header_block = loop_entry_blocks.size() > 0 ? block_ids[loop_entry_blocks[0]] : "";
+    loop_entry.header_block = loop_entry_blocks.size() > 0 ? block_ids.at(loop_entry_blocks[0], funcIndex) : "";
     loop_entry.latch_block = "";
 
     totalLoops++;
@@ -152,12 +212,12 @@ LoopEntry printLoopEntry(map<ParseAPI::Block *, string> &block_ids, ParseAPI::Lo
     if (!backedges.empty()) {
       for (auto &e : backedges) {
         loop_entry.backedges.emplace_back(
-            block_ids[e->src()], block_ids[e->trg()]);
+            block_ids.at(e->src(), funcIndex), block_ids.at(e->trg(), funcIndex));
       }
     }
-    for (auto &block : blocks) loop_entry.blocks.push_back(block_ids[block]);
+    for (auto &block : blocks) loop_entry.blocks.push_back(block_ids.at(block, funcIndex));
   }
-  for (auto &i : lt.children) loop_entry.loops.push_back(printLoopEntry(block_ids, *i));
+  for (auto &i : lt.children) loop_entry.loops.push_back(printLoopEntry(block_ids, funcIndex, *i));
   return loop_entry;
 }
 
@@ -243,197 +303,191 @@ bool matchOperands(const vector<signed int> &readSet,
 
 string block_to_name(const ParseAPI::Function *fn, const ParseAPI::Block *block,
                      const int cur_id) {
-  return print_clean_string(fn->name() + ": B" + Dyninst::itos(cur_id));
+  char id[16];
+  auto idEnd = std::to_chars(id, id + sizeof(id), cur_id).ptr;
+  const auto &fnName = fn->name();
+  auto name = string();
+  name.reserve(fnName.size() + 3 + (idEnd - id));
+  name.append(fnName).append(": B").append(id, idEnd);
+  clean_string_in_place(name);
+  return name;
 }
 
-vector<VariableInfo> getInstructionVariables(
-    const vector<VariableInfo> &localVars, const vector<VariableInfo> &params,
-    const string &instructionString) {
-  auto allVars = vector<VariableInfo>();
-  for (auto &varInfo : localVars) {
-    for(const auto &location : varInfo.locations) {
-      if(instructionString.find(location.location) != string::npos) {
-        allVars.push_back(varInfo);
-      }
-    }
+// The variable locations of a function indexed by address. The location ranges
+// cut the address space into segments, each listing the locations live in it.
+class VariableIndex {
+ public:
+  VariableIndex(const vector<VariableInfo> &localVars, const vector<VariableInfo> &params) {
+    auto add = [](const vector<VariableInfo> &vars, auto fn) {
+      for (const auto &varInfo : vars)
+        for (const auto &location : varInfo.locations)
+          // A location without operand text would match every instruction
+          if (!location.location.empty() && location.start < location.end) fn(varInfo, location);
+    };
+    auto collectBounds = [this](const VariableInfo &, const VarLocation &location) {
+      bounds.push_back(location.start);
+      bounds.push_back(location.end);
+    };
+    add(localVars, collectBounds);
+    add(params, collectBounds);
+    std::sort(bounds.begin(), bounds.end());
+    bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+
+    live.resize(bounds.size());
+    auto addLive = [this](const VariableInfo &varInfo, const VarLocation &location) {
+      auto first = std::lower_bound(bounds.begin(), bounds.end(), location.start) - bounds.begin();
+      auto last = std::lower_bound(bounds.begin(), bounds.end(), location.end) - bounds.begin();
+      for (auto i = first; i < last; i++) live[i].push_back({&varInfo, &location.location});
+    };
+    // Locals before params, in declaration order, like the variables of an instruction are listed
+    add(localVars, addLive);
+    add(params, addLive);
   }
-  for (auto &varInfo : params) {
-    for(const auto &location : varInfo.locations) {
-      if(instructionString.find(location.location) != string::npos) {
-        allVars.push_back(varInfo);
+
+  // The variables live at address whose location appears in the instruction, each once
+  vector<VariableInfo> match(const unsigned long address, const string &instructionString) const {
+    auto allVars = vector<VariableInfo>();
+    auto segment = std::upper_bound(bounds.begin(), bounds.end(), address) - bounds.begin();
+    if (segment == 0) return allVars;
+
+    const VariableInfo *lastMatched = nullptr;
+    for (const auto &[varInfo, pattern] : live[segment - 1]) {
+      if (varInfo == lastMatched) continue;
+      if (instructionString.find(*pattern) != string::npos) {
+        allVars.push_back(*varInfo);
+        lastMatched = varInfo;
       }
     }
+    return allVars;
   }
-  
-  return allVars;
-}
-
-void addLoopsToBlocks(vector<BlockInfo> &blocks, const LoopEntry &loop,
-                      unordered_map<string, int> &loop_count) {
-  for (auto &block : blocks) {
-    if (find(loop.blocks.begin(), loop.blocks.end(), block.name) !=
-        loop.blocks.end()) {
-      auto innerLoopIt = loop.loops.begin();
-      for(; innerLoopIt != loop.loops.end(); innerLoopIt++) {
-        if (find(innerLoopIt->blocks.begin(), innerLoopIt->blocks.end(),
-                      block.name) != innerLoopIt->blocks.end()) {
-          break;
-        }
-      }
-      if (innerLoopIt == loop.loops.end()) {
-        loop_count[loop.name]++;
-      }
-      block.loops.push_back({loop.name, loop_count[loop.name], -1});
 
-      for (const auto &backedge : loop.backedges) {
-        if (backedge.first == block.name) {
-          block.backedges.push_back(backedge.second);
-        }
-      }
-    }
+ private:
+  struct LiveLocation {
+    const VariableInfo *var;
+    const string *pattern;
+  };
+  vector<unsigned long> bounds;       // sorted and unique
+  vector<vector<LiveLocation>> live;  // live[i] covers [bounds[i], bounds[i + 1])
+};
+
+// A LoopEntry with its blocks as dense block indices of one function (positions
+// in Function::blocks()), so loop membership is a bit test instead of a name search
+struct LoopBlocks {
+  string name;
+  vector<bool> contains;  // by block index
+  int header = -1;        // block index of the loop entry, -1 without one
+  vector<std::pair<unsigned int, string>> backedges;  // (source block index, target block name)
+  vector<LoopBlocks> loops;
+};
+
+LoopBlocks indexLoopBlocks(const LoopEntry &loop, const unordered_map<string, unsigned int> &blockIndices,
+                           vector<bool> &loopHeaders) {
+  auto result = LoopBlocks{loop.name, vector<bool>(blockIndices.size())};
+  for (const auto &block : loop.blocks) {
+    auto it = blockIndices.find(block);
+    if (it != blockIndices.end()) result.contains[it->second] = true;
   }
-  if (loop.loops.size() > 0) {
-    for (const auto &innerLoop : loop.loops) {
-      addLoopsToBlocks(blocks, innerLoop, loop_count);
-    }
+  auto header = blockIndices.find(loop.header_block);
+  if (header != blockIndices.end()) {
+    result.header = header->second;
+    loopHeaders[header->second] = true;
   }
+  for (const auto &backedge : loop.backedges) {
+    auto it = blockIndices.find(backedge.first);
+    if (it != blockIndices.end()) result.backedges.emplace_back(it->second, backedge.second);
+  }
+  for (const auto &innerLoop : loop.loops)
+    result.loops.push_back(indexLoopBlocks(innerLoop, blockIndices, loopHeaders));
+  return result;
 }
 
-vector<unsigned int> getAllBlocksInLoop(const vector<BlockInfo> &funcBlocks, 
-                                     const vector<unsigned int> &blocks,
-                                     const LoopEntry &loop,
-                                     vector<unsigned int> &visitedBlocks) {
-  auto blocksInLoop = vector<unsigned int>();
-  auto currLoopBlocks = vector<unsigned int>();
-  copy_if(blocks.begin(), blocks.end(), back_inserter(currLoopBlocks),
-          [&loop ,&funcBlocks](const unsigned int b) {
-            return find(loop.blocks.begin(), loop.blocks.end(), funcBlocks[b].name) !=
-                   loop.blocks.end();
-          });
-  for (const auto &block : currLoopBlocks) {
-    if (find(visitedBlocks.begin(), visitedBlocks.end(), block) !=
-        visitedBlocks.end())
-      continue;
-
-    if (loop.loops.size() > 0) {
-      auto innerLoopIt = loop.loops.begin();
-      for (; innerLoopIt != loop.loops.end(); ++innerLoopIt) {
-        const auto &innerLoop = *innerLoopIt;
-        if (find(innerLoop.blocks.begin(), innerLoop.blocks.end(),
-                 funcBlocks[block].name) != innerLoop.blocks.end()) {
-          auto innerLoopBlocks =
-              getAllBlocksInLoop(funcBlocks, blocks, innerLoop, visitedBlocks);
+// blocks[i] has the block index blockIndex[i]
+void addLoopsToBlocks(vector<BlockInfo> &blocks, const vector<unsigned int> &blockIndex,
+                      const LoopBlocks &loop, unordered_map<string, int> &loop_count) {
+  for (size_t i = 0; i < blocks.size(); i++) {
+    auto index = blockIndex[i];
+    if (!loop.contains[index]) continue;
 
+    auto inInnerLoop = std::any_of(loop.loops.begin(), loop.loops.end(), [index](const LoopBlocks &innerLoop) {
+      return innerLoop.contains[index];
+    });
+    if (!inInnerLoop) {
+      loop_count[loop.name]++;
+    }
+    blocks[i].loops.push_back({loop.name, loop_count[loop.name], -1});
 
-          blocksInLoop.insert(blocksInLoop.end(), std::make_move_iterator(innerLoopBlocks.begin()),
-                              std::make_move_iterator(innerLoopBlocks.end()));
-          break;
-        }
-      }
-      if (innerLoopIt == loop.loops.end()) {
-        visitedBlocks.push_back(block);
-        blocksInLoop.push_back(block);
+    for (const auto &backedge : loop.backedges) {
+      if (backedge.first == index) {
+        blocks[i].backedges.push_back(backedge.second);
       }
-    } else {
-      visitedBlocks.push_back(block);
-      blocksInLoop.push_back(block);
     }
   }
-  // find the loop entry block and reorder it to the first place in tmp
-  auto header_block_it = std::find_if(blocksInLoop.begin(), blocksInLoop.end(), [&loop,&funcBlocks](const unsigned int b) {
-    return loop.header_block == funcBlocks[b].name;
-  });
-  if(header_block_it != blocksInLoop.end()) {
-    auto tmp = vector<unsigned int>();
-    tmp.push_back(*header_block_it);
-    for(auto &b : blocksInLoop) {
-      if(b != *header_block_it) tmp.push_back(b);
-    }
-    blocksInLoop = std::move(tmp);
+  for (const auto &innerLoop : loop.loops) {
+    addLoopsToBlocks(blocks, blockIndex, innerLoop, loop_count);
   }
-  return blocksInLoop;
 }
 
-vector<int> getBlockHeights(const vector<BlockInfo> &blocks) {
-  auto blockHeights = vector<int>(); blockHeights.reserve(blocks.size());
-  std::transform(blocks.begin(), blocks.end(), std::back_inserter(blockHeights), [](const BlockInfo &b) {
-    return b.block_type == BlockInfo::BLOCK_TYPE_NORMAL ? b.nInstructions : 0;
-  });
-  return blockHeights;
-}
+// A block position, or an inner loop placed where its first block is
+using LoopItem = std::pair<const LoopBlocks *, unsigned int>;  // (inner loop, 0) or (nullptr, position)
 
-vector<vector<string>> getBlockTypes(const vector<BlockInfo> &blocks) {
-  auto blockTypes = vector<vector<string>>(); blockTypes.reserve(blocks.size());
-  std::transform(blocks.begin(), blocks.end(), std::back_inserter(blockTypes), [](const BlockInfo &b) {
-    auto thisBlockType = std::unordered_set<string>();
-    for(const auto &ins: b.instructions) {
-      for(const auto &flag: ins.flags) {
-        if(flag == INST_VECTORIZED) {
-          thisBlockType.insert("vectorized");
-        }
-        else if(flag == INST_MEMORY_READ) {
-          thisBlockType.insert("call");
-        }
-        else if(flag == INST_MEMORY_WRITE) {
-          thisBlockType.insert("syscall");
-        }
-        else if(flag == INST_CALL) {
-          thisBlockType.insert("memory_read");
-        }
-        else if(flag == INST_SYSCALL) {
-          thisBlockType.insert("memory_write");
-        }
-        else if(flag == INST_FP) {
-          thisBlockType.insert("fp");
-        }
-      }
+// Lays out the items of loop (of the whole function when loop is nullptr) in
+// loop order: inner loops are expanded in place and the header of the loop is
+// moved to its front. blockIndex maps positions to block indices.
+vector<unsigned int> layoutLoopItems(const vector<LoopItem> &items, const LoopBlocks *loop,
+                                     const unordered_map<const LoopBlocks *, vector<LoopItem>> &loopItems,
+                                     const vector<unsigned int> &blockIndex) {
+  auto blocksInLoop = vector<unsigned int>();
+  for (const auto &[innerLoop, position] : items) {
+    if (!innerLoop) {
+      blocksInLoop.push_back(position);
+      continue;
     }
-    return vector<string>(thisBlockType.begin(), thisBlockType.end());
+    auto innerLoopBlocks = layoutLoopItems(loopItems.at(innerLoop), innerLoop, loopItems, blockIndex);
+    blocksInLoop.insert(blocksInLoop.end(), innerLoopBlocks.begin(), innerLoopBlocks.end());
+  }
+  if (!loop) return blocksInLoop;
+
+  // find the loop entry block and move it to the first place
+  auto header_block_it = std::find_if(blocksInLoop.begin(), blocksInLoop.end(), [loop, &blockIndex](const unsigned int b) {
+    return (int)blockIndex[b] == loop->header;
   });
-  return blockTypes;
+  if (header_block_it != blocksInLoop.end())
+    std::rotate(blocksInLoop.begin(), header_block_it, header_block_it + 1);
+  return blocksInLoop;
 }
 
-vector<bool> getIsBuiltInBlock(const vector<BlockInfo> &blocks) {
-  auto systemLocations = vector<string>{
+// Source files under these directories are system headers
+bool isSystemSourceFile(const string &sourceFile) {
+  static const auto systemLocations = vector<string>{
       "/usr/",
   };
-  auto isBuiltInBlock = vector<bool>(); isBuiltInBlock.reserve(blocks.size());
-  std::transform(
-      blocks.begin(), blocks.end(), std::back_inserter(isBuiltInBlock),
-      [&systemLocations](const BlockInfo &b) {
-        for(const auto &ins: b.instructions) {
-          for(const auto &correspondence: ins.correspondence) {
-            auto sourceFile = correspondence.first;
-            for (const auto &systemLocation : systemLocations) {
-              if (sourceFile.size() > systemLocation.size()) {
-                if (equal(sourceFile.begin(),
-                          sourceFile.begin() + systemLocation.size(),
-                          systemLocation.begin()))
-                  return true;
-              }
-            }
-          }
-        }
-
-        return false;
-      });
-  return isBuiltInBlock;
-}
-
-vector<int> getBlockStartAddresses(const vector<BlockInfo> &blocks) {
-  auto blockStartAddresses = vector<int>(); blockStartAddresses.reserve(blocks.size());
-  std::transform(blocks.begin(), blocks.end(), std::back_inserter(blockStartAddresses), [](const BlockInfo &b) {
-    return b.startAddress;
-  });
-  return blockStartAddresses;
+  for (const auto &systemLocation : systemLocations) {
+    if (sourceFile.size() > systemLocation.size() && sourceFile.starts_with(systemLocation)) return true;
+  }
+  return false;
 }
 
-vector<int> getBlockIndents(const vector<BlockInfo> &blocks) {
-  auto blockIndents = vector<int>(); blockIndents.reserve(blocks.size());
-  std::transform(blocks.begin(), blocks.end(), std::back_inserter(blockIndents), [](const BlockInfo &b) {
-    return b.loops.size();
-  });
-  return blockIndents;
+// Every minimap column in one pass over the blocks, using the flag summaries of the blocks
+MinimapInfo makeMinimapInfo(const vector<BlockInfo> &blocks) {
+  // Indexed by INSTRUCTION_FLAGS
+  static const char *blockTypeNames[] = {"vectorized", "call", "syscall", "memory_read", "memory_write", "fp"};
+  auto minimap = MinimapInfo();
+  minimap.block_heights.reserve(blocks.size());
+  minimap.built_in_blocks.reserve(blocks.size());
+  minimap.block_start_address.reserve(blocks.size());
+  minimap.block_loop_indents.reserve(blocks.size());
+  minimap.block_types.reserve(blocks.size());
+  for (const auto &b : blocks) {
+    minimap.block_heights.push_back(b.block_type == BlockInfo::BLOCK_TYPE_NORMAL ? b.nInstructions : 0);
+    minimap.built_in_blocks.push_back(b.builtIn);
+    minimap.block_start_address.push_back(b.startAddress);
+    minimap.block_loop_indents.push_back(b.loops.size());
+    auto &blockType = minimap.block_types.emplace_back();
+    for (int flag = INST_VECTORIZED; flag <= INST_FP; flag++) {
+      if (b.flags.contains(INSTRUCTION_FLAGS(flag))) blockType.push_back(blockTypeNames[flag]);
+    }
+  }
+  return minimap;
 }
 
 void getInlines(const set<SymtabAPI::InlinedFunction*> &inlineFuncs, vector<InlineEntry> &result) {
@@ -465,473 +519,858 @@ void getInlines(const set<SymtabAPI::InlinedFunction*> &inlineFuncs, vector<Inli
   }
 }
 
-void addLoopHeaderInfo(BlockInfo &block, const vector<LoopEntry> &loops) {
-  for (const auto &loop : loops) {
-    if(loop.header_block == block.name) {
-      block.isLoopHeader = true;
-    }
+// Calls fn(index, worker) for every index in [0, n) from nWorkers threads.
+// The first exception thrown by a worker is rethrown on the calling thread.
+template <typename Fn>
+void parallelFor(const size_t n, const unsigned int nWorkers, Fn &&fn) {
+  if (nWorkers <= 1) {
+    for (size_t i = 0; i < n; i++) fn(i, 0u);
+    return;
   }
-  if(!block.isLoopHeader) {
-    for (const auto &loop : loops) {
-      addLoopHeaderInfo(block, loop.loops);
-    }
+  auto next = std::atomic<size_t>(0);
+  auto error = std::exception_ptr();
+  auto errorMutex = std::mutex();
+  auto workers = vector<std::thread>();
+  for (unsigned int w = 0; w < nWorkers; w++) {
+    workers.emplace_back([&, w]() {
+      try {
+        for (auto i = next++; i < n; i = next++) fn(i, w);
+      } catch (...) {
+        auto lock = std::lock_guard(errorMutex);
+        if (!error) error = std::current_exception();
+        next = n;
+      }
+    });
   }
+  for (auto &worker : workers) worker.join();
+  if (error) std::rethrow_exception(error);
 }
 
-std::tuple<vector<BlockInfo>, vector<BlockInfo>, unordered_map<string, map<int, vector<unsigned long>>>, set<string>, vector<FunctionInfo>, unordered_map<std::string, std::map<int, std::unordered_set<SourceCodeTags>>>> getAssembly(SymtabAPI::Symtab *symtab, const ParseAPI::CodeObject::funclist &funcs) {
-
-  auto bar = indicators::ProgressBar{
-    indicators::option::BarWidth{50},
-    indicators::option::MaxProgress{funcs.size()},
-    indicators::option::Start{" ["},
-    indicators::option::Fill{"█"},
-    indicators::option::Lead{"█"},
-    indicators::option::Remainder{"-"},
-    indicators::option::End{"]"},
-    indicators::option::PrefixText{"Disassembling"},
-    indicators::option::ForegroundColor{indicators::Color::yellow},
-    indicators::option::ShowElapsedTime{true},
-    indicators::option::ShowRemainingTime{true},
-    indicators::option::FontStyles{std::vector<indicators::FontStyle>{indicators::FontStyle::bold}}
-  };
+InstructionAPI::InstructionDecoder makeDecoder(const ParseAPI::Function *f) {
+  return InstructionAPI::InstructionDecoder(
+      f->isrc()->getPtrToInstruction(f->addr()),
+      InstructionAPI::InstructionDecoder::maxInstructionLength, f->region()->getArch());
+}
 
-  auto addressOrderBlocks = vector<BlockInfo>();
-  auto loopOrderBlocks = vector<BlockInfo>();
-  auto __visitedBlocks = unordered_map<ParseAPI::Block*, bool>();
-  auto source_correspondences = unordered_map<string, map<int, vector<unsigned long>>>();
-  auto block_ids = map<ParseAPI::Block *, string>();
-  auto instruction_flags = map<Dyninst::Address, std::unordered_set<INSTRUCTION_FLAGS>>();
-  auto unique_sourcefiles = set<string>();
-  auto curr_block_id = 0;
-  auto sourceCodeInfo = unordered_map<std::string, std::map<int, std::unordered_set<SourceCodeTags>>>(); 
-  auto functionInfos = vector<FunctionInfo>();
-
-  // create an Instruction decoder which will convert the binary opcodes to strings
-  auto anyfunc = *funcs.begin();
-  auto decoder = InstructionAPI::InstructionDecoder(
-      anyfunc->isrc()->getPtrToInstruction(anyfunc->addr()),
-      InstructionAPI::InstructionDecoder::maxInstructionLength, anyfunc->region()->getArch());
-  
-  // Prepare all the addresses. This is needed in a separate for loop over function to get all addresses first
-  auto addresses = set<unsigned long>();
-  for (const auto &f : funcs) {
-    for (const auto &block : f->blocks()) {
-      auto icur = block->start();
-      auto iend = block->last();
-      while (icur <= iend) {
-        addresses.insert(icur);
-        auto raw_insnptr =
-            (const unsigned char *)f->isrc()->getPtrToInstruction(icur);
+// One decoded instruction. Every instruction of the binary is decoded,
+// formatted and looked up in the line table exactly once.
+struct DecodedInstruction {
+  Dyninst::Address address;
+  unsigned int length;
+  InstructionFlags flags;
+  string text;
+  std::span<const LineTable::Line> lines;
+};
+
+// Decodes every instruction of block and appends it to instructions
+void decodeBlock(const LineTable &lineTable, InstructionAPI::InstructionDecoder &decoder,
+                 const ParseAPI::Block *block, const ParseAPI::Function *f,
+                 vector<DecodedInstruction> &instructions, std::unordered_set<const string *> &sourceFiles) {
+  auto icur = block->start();
+  auto iend = block->last();
+  while (icur <= iend) {
+    auto raw_insnptr =
+        (const unsigned char *)f->isrc()->getPtrToInstruction(icur);
 #if defined(DYNINST_MAJOR_VERSION) && (DYNINST_MAJOR_VERSION >= 10)
-        auto instr = decoder.decode(raw_insnptr);
+    auto instr = decoder.decode(raw_insnptr);
 #else
-        auto ip = decoder.decode(raw_insnptr);
-        auto instr = *ip;
+    auto ip = decoder.decode(raw_insnptr);
+    auto instr = *ip;
 #endif
-        icur += instr.size();
-      }
-    }
+    auto decoded = DecodedInstruction{icur, (unsigned int)instr.size()};
+    setInstructionFlags(instr, decoded.flags);
+    decoded.text = instr.format();
+    decoded.lines = lineTable.at(icur); // an instruction can have multiple source lines
+    for(const auto &fl : decoded.lines) sourceFiles.insert(fl.file);
+
+    icur += decoded.length;
+    instructions.push_back(std::move(decoded));
   }
+}
 
-  // Create block names, unique source files and Inlines
-  for (const auto &f : funcs) {
-    // Assign block names and get unique source files
-    for (const auto &block : f->blocks()) {
-      auto icur = block->start();
-      auto iend = block->last();
-      while (icur <= iend) {
-        auto cur_lines = vector<SymtabAPI::Statement::Ptr>();
-        symtab->getSourceLines(cur_lines, icur);
-        // if (cur_lines.empty()) continue;
-        for(auto &fl : cur_lines) unique_sourcefiles.insert(fl->getFile());
+// Sorts an instruction table by address and drops instructions decoded through more than one block
+void sortInstructions(vector<DecodedInstruction> &instructions) {
+  std::sort(instructions.begin(), instructions.end(), [](const DecodedInstruction &a, const DecodedInstruction &b) {
+    return a.address < b.address;
+  });
+  instructions.erase(std::unique(instructions.begin(), instructions.end(), [](const DecodedInstruction &a, const DecodedInstruction &b) {
+    return a.address == b.address;
+  }), instructions.end());
+}
 
-        auto raw_insnptr =
-            (const unsigned char *)f->isrc()->getPtrToInstruction(icur);
+vector<DecodedInstruction>::const_iterator firstInstruction(const vector<DecodedInstruction> &instructions, const Dyninst::Address address) {
+  return std::lower_bound(instructions.begin(), instructions.end(), address,
+                          [](const DecodedInstruction &i, const Dyninst::Address a) { return i.address < a; });
+}
+
+// What the analysis of one function reads from the parts of Dyninst that are parsed lazily
+struct FunctionSymbols {
+  unique_ptr<ParseAPI::LoopTreeNode> loopTree;
+  set<SymtabAPI::FunctionBase *> topLevelFuncs; // symtab functions containing its blocks
+  vector<SymtabAPI::localVar *> localVars;
+  vector<SymtabAPI::localVar *> params;
+};
+
+// Binary-wide data every function analysis reads from
+struct AnalysisContext {
+  SymtabAPI::Symtab *symtab;
+  bool lazy;
+  vector<DecodedInstruction> instructions; // sorted by address, one entry per address. Empty in lazy mode
+  LineTable lineTable;
+  unordered_map<const string *, string> cleanFileNames; // print_clean_string of every line table file
+  BlockNames block_ids;
+  vector<std::pair<ParseAPI::Block *, ParseAPI::Function *>> blocks; // every block once with its first function, sorted by start address
+  vector<FunctionSymbols> functions; // by function index
+
+  // The block starting closest before address
+  const std::pair<ParseAPI::Block *, ParseAPI::Function *> *blockAt(const Dyninst::Address address) const {
+    auto it = std::upper_bound(blocks.begin(), blocks.end(), address, [](const Dyninst::Address a, const auto &b) {
+      return a < b.first->start();
+    });
+    if (it == blocks.begin()) return nullptr;
+    it--;
+    return address <= it->first->last() ? &*it : nullptr;
+  }
+
+  bool hasInstruction(const Dyninst::Address address, InstructionAPI::InstructionDecoder &decoder) const {
+    if (!lazy) {
+      auto it = firstInstruction(instructions, address);
+      return it != instructions.end() && it->address == address;
+    }
+    // Without the full table, walk the block containing the address
+    auto block = blockAt(address);
+    if (!block) return false;
+    auto icur = block->first->start();
+    while (icur < address) {
+      auto raw_insnptr =
+          (const unsigned char *)block->second->isrc()->getPtrToInstruction(icur);
 #if defined(DYNINST_MAJOR_VERSION) && (DYNINST_MAJOR_VERSION >= 10)
-        auto instr = decoder.decode(raw_insnptr);
+      icur += decoder.decode(raw_insnptr).size();
 #else
-        auto ip = decoder.decode(raw_insnptr);
-        auto instr = *ip;
+      icur += decoder.decode(raw_insnptr)->size();
 #endif
-        setInstructionFlags(instr, instruction_flags[icur]);
-        icur += instr.size();
-      }
-      block_ids[block] = block_to_name(f, block, curr_block_id++);
-    }
-
-    // Loops
-    auto funcLoops = vector<LoopEntry>();
-    auto lt = unique_ptr<ParseAPI::LoopTreeNode>(f->getLoopTree());
-    if (lt) {
-      funcLoops = printLoopEntry(block_ids, *lt).loops;
-    }
-    
-    // Hidables
-    // auto hidables = vector<Hidable>();
-    // auto fnBegin = getFuncBegin(f);
-    // if (!fnBegin.name.empty()) hidables.push_back(std::move(fnBegin));
-
-    auto funcBlocks = vector<BlockInfo>();
-    
-    // Inlines
-    auto topLevelFuncs = set<SymtabAPI::FunctionBase*>();
-    for(const auto &block: f->blocks()) {
+    }
+    return icur == address;
+  }
+};
+
+// Walks every level of inlines below func, which makes Dyninst parse them
+void parseInlines(SymtabAPI::FunctionBase *func) {
+  for (auto &inlined : SymtabAPI::InlineCollection(func->getInlines())) parseInlines(inlined);
+}
+
+// Names every block and lists the unique blocks of the binary. Loop trees, DWARF
+// functions, inlines and variables are parsed by Dyninst on first use, which it does
+// not document as thread safe, so everything the function analyses read from them is
+// parsed here on the calling thread.
+AnalysisContext prepareAnalysis(SymtabAPI::Symtab *symtab, const vector<ParseAPI::Function *> &funcList, const bool lazy) {
+  auto ctx = AnalysisContext{symtab, lazy};
+  ctx.lineTable = LineTable(symtab);
+  for (const auto &file : ctx.lineTable.files()) ctx.cleanFileNames.emplace(&file, print_clean_string(file));
+
+  // Block names are numbered in function order, so they are assigned before any work is split
+  auto curr_block_id = 0;
+  auto seenBlocks = std::unordered_set<ParseAPI::Block *>();
+  for (size_t i = 0; i < funcList.size(); i++) {
+    for (const auto &block : funcList[i]->blocks()) {
+      ctx.block_ids.assign(block, i, block_to_name(funcList[i], block, curr_block_id++));
+      if (seenBlocks.insert(block).second) ctx.blocks.emplace_back(block, funcList[i]);
+    }
+  }
+  std::sort(ctx.blocks.begin(), ctx.blocks.end(), [](const auto &a, const auto &b) {
+    return a.first->start() < b.first->start();
+  });
+
+  ctx.functions.resize(funcList.size());
+  for (size_t i = 0; i < funcList.size(); i++) {
+    auto &symbols = ctx.functions[i];
+    symbols.loopTree.reset(funcList[i]->getLoopTree());
+    for (const auto &block : funcList[i]->blocks()) {
       SymtabAPI::Function *symt_func = nullptr;
       symtab->getContainingFunction(block->start(), symt_func);
-      if(!symt_func) continue;
-      topLevelFuncs.insert(symt_func);
-    }
-    auto inlineFuncs = set<SymtabAPI::InlinedFunction*>();
-    if(!topLevelFuncs.empty()) {
-      for(auto &topLevelFunc: topLevelFuncs) {
-        auto ic = SymtabAPI::InlineCollection(topLevelFunc->getInlines());
-        for (auto &funcBase : ic) {
-          auto inlineFunc = static_cast<SymtabAPI::InlinedFunction *>(funcBase);          
-          if(addresses.find(inlineFunc->getOffset()) == addresses.end()) continue;
-          inlineFuncs.insert(inlineFunc);
-        }
-      }
+      if (symt_func && symbols.topLevelFuncs.insert(symt_func).second) parseInlines(symt_func);
     }
-    auto inlines = vector<InlineEntry>();
-    getInlines(inlineFuncs, inlines);
+    SymtabAPI::Function *symt_func = nullptr;
+    symtab->getContainingFunction(funcList[i]->addr(), symt_func);
+    if (!symt_func) continue;
+    symt_func->getLocalVariables(symbols.localVars);
+    symt_func->getParams(symbols.params);
+  }
+  return ctx;
+}
 
-    for(const auto &inlineEntry: inlines) {
-      if(sourceCodeInfo.find(inlineEntry.callsite_file) == sourceCodeInfo.end()) {
-        sourceCodeInfo[inlineEntry.callsite_file] = std::map<int, std::unordered_set<SourceCodeTags>>();
-      }
-      sourceCodeInfo[inlineEntry.callsite_file][inlineEntry.callsite_line].insert(
-        SourceCodeTags::INLINE_TAG
-      );
-    }
-    
-    // Calls
-    auto calls = vector<Call>();
-    for (auto &edge : f->callEdges()) {
-      if (!edge) continue;
-      auto from = edge->src();
-      auto to = edge->trg();
-
-      auto call = Call{
-        from->lastInsnAddr(),
-      };
-
-      if (to && to->start() != (unsigned long)-1)
-        call.target = to->start();
-      else
-        call.target = 0;
-
-      auto funcs = vector<ParseAPI::Function *>();
-      to->getFuncs(funcs);
-      if (!funcs.empty()) {
-        for (auto j = funcs.begin(); j != funcs.end(); j++)
-          call.targetFuncNames.push_back(print_clean_string((*j)->name()));
+// Everything one function contributes to the BinaryCacheResult
+struct FunctionAnalysis {
+  vector<BlockInfo> addressOrderBlocks;
+  vector<BlockInfo> loopOrderBlocks;
+  FunctionInfo functionInfo;
+  unordered_map<string, map<int, vector<unsigned long>>> correspondences;
+  unordered_map<std::string, std::map<int, std::unordered_set<SourceCodeTags>>> sourceCodeInfo;
+  std::unordered_set<const string *> sourceFiles; // only filled in lazy mode, otherwise collected while decoding
+};
+
+FunctionAnalysis analyzeFunction(const AnalysisContext &ctx, ParseAPI::Function *f, const size_t funcIndex, InstructionAPI::InstructionDecoder &decoder) {
+  const auto &block_ids = ctx.block_ids;
+  auto result = FunctionAnalysis();
+  auto &source_correspondences = result.correspondences;
+  auto &sourceCodeInfo = result.sourceCodeInfo;
+
+  // In lazy mode only the instructions of this function are decoded
+  auto ownInstructions = vector<DecodedInstruction>();
+  if (ctx.lazy) {
+    for (const auto &block : f->blocks())
+      decodeBlock(ctx.lineTable, decoder, block, f, ownInstructions, result.sourceFiles);
+    sortInstructions(ownInstructions);
+  }
+  const auto &instructions = ctx.lazy ? ownInstructions : ctx.instructions;
+
+  // Loops
+  auto funcLoops = vector<LoopEntry>();
+  const auto &symbols = ctx.functions[funcIndex];
+  if (symbols.loopTree) {
+    funcLoops = printLoopEntry(block_ids, funcIndex, *symbols.loopTree).loops;
+  }
+
+  // Hidables
+  // auto hidables = vector<Hidable>();
+  // auto fnBegin = getFuncBegin(f);
+  // if (!fnBegin.name.empty()) hidables.push_back(std::move(fnBegin));
+
+  auto funcBlocks = vector<BlockInfo>();
+
+  // Inlines
+  const auto &topLevelFuncs = symbols.topLevelFuncs;
+  auto inlineFuncs = set<SymtabAPI::InlinedFunction*>();
+  if(!topLevelFuncs.empty()) {
+    for(auto &topLevelFunc: topLevelFuncs) {
+      auto ic = SymtabAPI::InlineCollection(topLevelFunc->getInlines());
+      for (auto &funcBase : ic) {
+        auto inlineFunc = static_cast<SymtabAPI::InlinedFunction *>(funcBase);
+        if(!ctx.hasInstruction(inlineFunc->getOffset(), decoder)) continue;
+        inlineFuncs.insert(inlineFunc);
       }
-      calls.push_back(call);
-    }
-    
-    auto funcInfo = FunctionInfo{
-      print_clean_string(f->name()),
-      f->entry()->start(),
-      {},
-      {},
-      {},
-      calls,
-      inlines,
-      funcLoops,
-      {} // hidables
+    }
+  }
+  auto inlines = vector<InlineEntry>();
+  getInlines(inlineFuncs, inlines);
+
+  for(const auto &inlineEntry: inlines) {
+    if(sourceCodeInfo.find(inlineEntry.callsite_file) == sourceCodeInfo.end()) {
+      sourceCodeInfo[inlineEntry.callsite_file] = std::map<int, std::unordered_set<SourceCodeTags>>();
+    }
+    sourceCodeInfo[inlineEntry.callsite_file][inlineEntry.callsite_line].insert(
+      SourceCodeTags::INLINE_TAG
+    );
+  }
+
+  // Calls
+  auto calls = vector<Call>();
+  for (auto &edge : f->callEdges()) {
+    if (!edge) continue;
+    auto from = edge->src();
+    auto to = edge->trg();
+
+    auto call = Call{
+      from->lastInsnAddr(),
     };
-    
-    // Function variables
-    SymtabAPI::Function *symt_func = nullptr;
-    symtab->getContainingFunction(f->addr(), symt_func);
-
-    auto thisLocalVars = vector<SymtabAPI::localVar *>();
-    auto thisParams = vector<SymtabAPI::localVar *>();
-    symt_func->getLocalVariables(thisLocalVars);
-    symt_func->getParams(thisParams);
-
-    auto localVars = vector<VariableInfo>();
-    for (auto var : thisLocalVars) {
-      auto varInfo = printVar(var);
-      varInfo.var_type = VariableInfo::VAR_TYPE_LOCAL;
-      localVars.push_back(std::move(varInfo));
-    }
-    auto params = vector<VariableInfo>();
-    for (auto var : thisParams) {
-      auto varInfo = printVar(var);
-      varInfo.var_type = VariableInfo::VAR_TYPE_PARAM;
-      params.push_back(std::move(varInfo));
-    }
-    
-    funcInfo.localVars = std::move(localVars);
-    funcInfo.params = std::move(params);
-
-    for (const auto &block : f->blocks()) {
-      auto insns = ParseAPI::Block::Insns();
-      block->getInsns(insns);
-
-      auto blockInfo = BlockInfo{
-          block_ids[block],
-          {},
-          print_clean_string(f->name()),
-      };
-      funcInfo.basic_blocks.push_back(blockInfo.name);
-
-      // for (const auto &hidable : hidables) {
-      //   if (hidable.start >= block->start() && hidable.end <= block->last()) {
-      //     blockInfo.hidables.push_back(std::move(hidable)); // maybe gotcha
-      //   }
-      // }
-
-      for (const auto &edge : block->targets()) {
-        auto sourcei = block_ids.find(edge->src());
-        auto targeti = block_ids.find(edge->trg());
-        if (sourcei == block_ids.end() || targeti == block_ids.end()) continue;
-        blockInfo.nextBlockNames.push_back(targeti->second);
-      }
 
-      // TODO: check if correspondence have multiple instruction lines per source line
-      //TODO: CHeck SymtabAPI::Statement::Ptr::getLine() for multiple line number
-      for (const auto &instr : insns) {
-        // Correspondences
-        auto cur_lines = vector<SymtabAPI::Statement::Ptr>();
-        symtab->getSourceLines(cur_lines, instr.first); // getSourceLines should give multiple source lines per instruction.
-        auto correspondences = unordered_map<string, vector<int> >();
-        for (const auto &li : cur_lines) {
-          correspondences[print_clean_string(li->getFile())].push_back(li->getLine());
-          source_correspondences[print_clean_string(li->getFile())][li->getLine()].push_back(instr.first);
-        }
+    if (to && to->start() != (unsigned long)-1)
+      call.target = to->start();
+    else
+      call.target = 0;
+
+    auto funcs = vector<ParseAPI::Function *>();
+    to->getFuncs(funcs);
+    if (!funcs.empty()) {
+      for (auto j = funcs.begin(); j != funcs.end(); j++)
+        call.targetFuncNames.push_back(print_clean_string((*j)->name()));
+    }
+    calls.push_back(call);
+  }
+
+  auto funcInfo = FunctionInfo{
+    print_clean_string(f->name()),
+    f->entry()->start(),
+    {},
+    {},
+    {},
+    calls,
+    inlines,
+    funcLoops,
+    {} // hidables
+  };
 
+  // Function variables
+  const auto &thisLocalVars = symbols.localVars;
+  const auto &thisParams = symbols.params;
 
-        blockInfo.instructions.push_back({
-            instr.first,
-            instr.second.format(),
-            correspondences,
-            getInstructionVariables(funcInfo.localVars, funcInfo.params, instr.second.format()),
-            instruction_flags[instr.first],
-        });
-        
+  auto localVars = vector<VariableInfo>();
+  for (auto var : thisLocalVars) {
+    auto varInfo = printVar(var);
+    varInfo.var_type = VariableInfo::VAR_TYPE_LOCAL;
+    localVars.push_back(std::move(varInfo));
+  }
+  auto params = vector<VariableInfo>();
+  for (auto var : thisParams) {
+    auto varInfo = printVar(var);
+    varInfo.var_type = VariableInfo::VAR_TYPE_PARAM;
+    params.push_back(std::move(varInfo));
+  }
+
+  funcInfo.localVars = std::move(localVars);
+  funcInfo.params = std::move(params);
+  auto variableIndex = VariableIndex(funcInfo.localVars, funcInfo.params);
+
+  // Dense block indices, in f->blocks() order
+  auto blockIndices = unordered_map<string, unsigned int>();
+  for (const auto &block : f->blocks()) {
+    auto index = (unsigned int)blockIndices.size();
+    blockIndices.emplace(block_ids.at(block, funcIndex), index);
+  }
+  auto loopHeaders = vector<bool>(blockIndices.size());
+  auto loopBlocks = vector<LoopBlocks>();
+  for (const auto &loop : funcLoops) loopBlocks.push_back(indexLoopBlocks(loop, blockIndices, loopHeaders));
+
+  for (const auto &block : f->blocks()) {
+    auto blockInfo = BlockInfo{
+        block_ids.at(block, funcIndex),
+        {},
+        print_clean_string(f->name()),
+    };
+    funcInfo.basic_blocks.push_back(blockInfo.name);
+
+    // for (const auto &hidable : hidables) {
+    //   if (hidable.start >= block->start() && hidable.end <= block->last()) {
+    //     blockInfo.hidables.push_back(std::move(hidable)); // maybe gotcha
+    //   }
+    // }
+
+    for (const auto &edge : block->targets()) {
+      auto sourcei = block_ids.find(edge->src(), funcIndex);
+      auto targeti = block_ids.find(edge->trg(), funcIndex);
+      if (!sourcei || !targeti) continue;
+      blockInfo.nextBlockNames.push_back(*targeti);
+    }
+
+    // TODO: check if correspondence have multiple instruction lines per source line
+    //TODO: CHeck SymtabAPI::Statement::Ptr::getLine() for multiple line number
+    for (auto instr = firstInstruction(instructions, block->start());
+         instr != instructions.end() && instr->address <= block->last(); instr++) {
+      // Correspondences
+      auto correspondences = unordered_map<string, vector<int> >();
+      for (const auto &li : instr->lines) {
+        const auto &file = ctx.cleanFileNames.at(li.file);
+        correspondences[file].push_back(li.line);
+        source_correspondences[file][li.line].push_back(instr->address);
+        if (!blockInfo.builtIn && isSystemSourceFile(file)) blockInfo.builtIn = true;
       }
+      blockInfo.flags |= instr->flags;
+      for (int flag = INST_VECTORIZED; flag <= INST_FP; flag++)
+        blockInfo.flagCounts[flag] += instr->flags.contains(INSTRUCTION_FLAGS(flag));
+
+      blockInfo.instructions.push_back({
+          instr->address,
+          instr->text,
+          correspondences,
+          variableIndex.match(instr->address, instr->text),
+          instr->flags,
+      });
 
-      blockInfo.startAddress = block->start();
-      blockInfo.endAddress = block->last();
-      blockInfo.nInstructions = blockInfo.instructions.size();
-      addLoopHeaderInfo(blockInfo, funcLoops);
-
-      for (const auto &inst: blockInfo.instructions) {
-        if (inst.flags.find(INST_VECTORIZED) != inst.flags.end()) {
-          for (const auto &correspondence: inst.correspondence) {
-            auto sourceFile = correspondence.first;
-            for (const auto &line: correspondence.second) {
-              if (sourceCodeInfo.find(sourceFile) == sourceCodeInfo.end())
-                sourceCodeInfo[sourceFile] = std::map<int, std::unordered_set<SourceCodeTags>>();
-              sourceCodeInfo[sourceFile][line].insert(SourceCodeTags::VECTORIZED_TAG);
-            }
+    }
+
+    blockInfo.startAddress = block->start();
+    blockInfo.endAddress = block->last();
+    blockInfo.nInstructions = blockInfo.instructions.size();
+    blockInfo.isLoopHeader = loopHeaders[funcBlocks.size()];
+
+    for (const auto &inst: blockInfo.instructions) {
+      if (inst.flags.contains(INST_VECTORIZED)) {
+        for (const auto &correspondence: inst.correspondence) {
+          auto sourceFile = correspondence.first;
+          for (const auto &line: correspondence.second) {
+            if (sourceCodeInfo.find(sourceFile) == sourceCodeInfo.end())
+              sourceCodeInfo[sourceFile] = std::map<int, std::unordered_set<SourceCodeTags>>();
+            sourceCodeInfo[sourceFile][line].insert(SourceCodeTags::VECTORIZED_TAG);
           }
         }
       }
+    }
 
-      // if (blockInfo.flags.find(bb_vectorized) != blockInfo.flags.end()) {
-      //   for (const auto &instr : blockInfo.instructions) {
-      //     for (const auto &correspondence : instr.correspondence) {
-      //       for (const auto &line : correspondence.second) {
-      //         if (sourceCodeInfo.find(correspondence.first) == sourceCodeInfo.end())
-      //           sourceCodeInfo[correspondence.first] = std::map<int, std::unordered_set<SourceCodeTags>>();
-      //         sourceCodeInfo[correspondence.first][line].insert(SourceCodeTags::VECTORIZED_TAG);
-      //       }
-      //     }
-      //   }
-      // }
-
-      funcBlocks.push_back(std::move(blockInfo));
-
-    }
-    int maxLoopCount = -1;
-    for (const auto &loop : funcLoops) {
-      auto loop_count = unordered_map<string, int>();
-      addLoopsToBlocks(funcBlocks, loop, loop_count);
-      for (auto &block : funcBlocks) {
-        if (block.loops.size() > maxLoopCount)
-          maxLoopCount = block.loops.size();
-
-        for (auto &loop : block.loops)
-          if (loop_count.find(loop.name) != loop_count.end())
-            loop.loopTotal = loop_count[loop.name];
-      }
+    // if (blockInfo.flags.find(bb_vectorized) != blockInfo.flags.end()) {
+    //   for (const auto &instr : blockInfo.instructions) {
+    //     for (const auto &correspondence : instr.correspondence) {
+    //       for (const auto &line : correspondence.second) {
+    //         if (sourceCodeInfo.find(correspondence.first) == sourceCodeInfo.end())
+    //           sourceCodeInfo[correspondence.first] = std::map<int, std::unordered_set<SourceCodeTags>>();
+    //         sourceCodeInfo[correspondence.first][line].insert(SourceCodeTags::VECTORIZED_TAG);
+    //       }
+    //     }
+    //   }
+    // }
+
+    funcBlocks.push_back(std::move(blockInfo));
+
+  }
+  // blockIndex[i] is the block index of funcBlocks[i]
+  auto blockIndex = vector<unsigned int>(funcBlocks.size());
+  std::iota(blockIndex.begin(), blockIndex.end(), 0);
+
+  int maxLoopCount = -1;
+  for (const auto &loop : loopBlocks) {
+    auto loop_count = unordered_map<string, int>();
+    addLoopsToBlocks(funcBlocks, blockIndex, loop, loop_count);
+    for (auto &block : funcBlocks) {
+      if (block.loops.size() > maxLoopCount)
+        maxLoopCount = block.loops.size();
+
+      for (auto &loop : block.loops)
+        if (loop_count.find(loop.name) != loop_count.end())
+          loop.loopTotal = loop_count[loop.name];
     }
-    
-    std::sort(funcBlocks.begin(), funcBlocks.end(), [](const BlockInfo &a, const BlockInfo &b) {
-      return a.startAddress < b.startAddress;
+  }
+  
+  std::sort(blockIndex.begin(), blockIndex.end(), [&funcBlocks](const unsigned int a, const unsigned int b) {
+    return funcBlocks[a].startAddress < funcBlocks[b].startAddress;
+  });
+  auto sortedBlocks = vector<BlockInfo>(); sortedBlocks.reserve(funcBlocks.size());
+  for (const auto index : blockIndex) sortedBlocks.push_back(std::move(funcBlocks[index]));
+  funcBlocks = std::move(sortedBlocks);
+  
+  // Pseudo loops: when a block is followed by a block outside its innermost loop
+  // before that loop is complete, the rest of the loop is repeated after it as
+  // pseudo blocks, once per loop
+  auto innermostLoopBlocks = unordered_map<string, vector<unsigned int>>();
+  for (unsigned int i = 0; i < funcBlocks.size(); i++)
+    if (funcBlocks[i].loops.size() > 0) innermostLoopBlocks[funcBlocks[i].loops.back().name].push_back(i);
+
+  auto processed_loops = std::unordered_set<string>();
+  auto laidOutBlocks = vector<BlockInfo>(); laidOutBlocks.reserve(funcBlocks.size());
+  auto laidOutIndex = vector<unsigned int>(); laidOutIndex.reserve(funcBlocks.size());
+  auto afterPseudoBlocks = false;
+  for (unsigned int idx = 0; idx < funcBlocks.size(); idx++) {
+    // Pseudo blocks are only copied from later positions, so this block can be moved
+    laidOutBlocks.push_back(std::move(funcBlocks[idx]));
+    laidOutIndex.push_back(blockIndex[idx]);
+    if (idx + 1 == funcBlocks.size()) break;
+    // The block following pseudo blocks does not start any itself
+    if (std::exchange(afterPseudoBlocks, false)) continue;
+
+    const auto &loops = laidOutBlocks.back().loops;
+    const auto &nextLoops = funcBlocks[idx + 1].loops;
+    if (loops.size() <= nextLoops.size() || processed_loops.count(loops.back().name))
+      continue;
+    auto nextInBlockLoops = std::all_of(nextLoops.begin(), nextLoops.end(), [&loops](const BlockLoopState &l) {
+      return std::any_of(loops.begin(), loops.end(), [&l](const BlockLoopState &bl) { return bl.name == l.name; });
     });
-    
-    auto processed_loops = vector<string>();
-    int idx = 0;
-    while (idx+1 < funcBlocks.size()) {
-      if (funcBlocks[idx].loops.size() > 0 && find(processed_loops.begin(), processed_loops.end(), funcBlocks[idx].loops.back().name) != processed_loops.end()) {
-        idx++;
-        continue;
-      }
-      
-      auto blockLoopNames = vector<string>();
-      std::transform(funcBlocks[idx].loops.begin(), funcBlocks[idx].loops.end(), std::back_inserter(blockLoopNames), [](const BlockLoopState &l) {
-        return l.name;
-      });
-      auto nextBlockLoopNames = vector<string>();
-      std::transform(funcBlocks[idx+1].loops.begin(), funcBlocks[idx+1].loops.end(), std::back_inserter(nextBlockLoopNames), [](const BlockLoopState &l) {
-        return l.name;
-      });
-      
-      if( std::all_of(nextBlockLoopNames.begin(), nextBlockLoopNames.end(), [&blockLoopNames](const string &l) {
-        return std::find(blockLoopNames.begin(), blockLoopNames.end(), l) != blockLoopNames.end();
-      }) && blockLoopNames.size() > nextBlockLoopNames.size()) {
-        // Check if this is the last block of this loop
-        if(funcBlocks[idx].loops.back().loopCount != funcBlocks[idx].loops.back().loopTotal) {
-          auto pseudo_blocks = vector<BlockInfo>();
-          auto it = funcBlocks.begin() + (idx + 1);
-          for(; it != funcBlocks.end(); it++) {
-            if (it->loops.size() > 0 && it->loops.back().name == funcBlocks[idx].loops.back().name && funcBlocks[idx].functionName == it->functionName) {
-              auto pseudoBlock = *it;
-              pseudoBlock.block_type = BlockInfo::BLOCK_TYPE_PSEUDOLOOP;
-              pseudo_blocks.push_back(std::move(pseudoBlock));
-              if(pseudo_blocks.back().loops.back().loopCount == pseudo_blocks.back().loops.back().loopTotal) {
-                break;
-              }
-            }
-          }
-          
-          processed_loops.push_back(funcBlocks[idx].loops.back().name);
-          idx++;
-          auto skips = pseudo_blocks.size();
-          funcBlocks.insert(funcBlocks.begin() + idx, make_move_iterator(pseudo_blocks.begin()), make_move_iterator(pseudo_blocks.end()));
-          idx += skips;
+    // Check if this is the last block of this loop
+    if (!nextInBlockLoops || loops.back().loopCount == loops.back().loopTotal)
+      continue;
 
-        }
-      }
-      idx++; 
-    }
-
-    // Loop Order blocks
-    auto __visitedBlocks = vector<unsigned int>();
-    auto funcLoopOrderBlocks = vector<BlockInfo>();
-    for (const auto &block : funcBlocks| boost::adaptors::indexed(0)) {
-      if (find(__visitedBlocks.begin(), __visitedBlocks.end(),
-                    block.index()) != __visitedBlocks.end())
-        continue;
-      if (block.value().loops.size() > 0) {
-        
-        auto blockLoopNames = vector<string>(); blockLoopNames.reserve(funcLoops.size());
-        std::transform(block.value().loops.begin(), block.value().loops.end(), std::back_inserter(blockLoopNames), [](const BlockLoopState &l) {
-          return l.name;
-        });
-        auto foundLoop = std::find_if(funcLoops.begin(), funcLoops.end(), [&blockLoopNames](const LoopEntry &l) {
-          return std::find(blockLoopNames.begin(), blockLoopNames.end(), l.name) != blockLoopNames.end();
-        });
-        auto currLoop = (foundLoop != funcLoops.end()) ? *foundLoop : LoopEntry();
-
-        auto currLoopBlocks = vector<unsigned int>();
-        for(const auto &b : funcBlocks| boost::adaptors::indexed(0)) {
-          if (find(currLoop.blocks.begin(), currLoop.blocks.end(), b.value().name) != currLoop.blocks.end())
-            currLoopBlocks.push_back(b.index());
-        }
-        auto tmp = getAllBlocksInLoop(funcBlocks, currLoopBlocks, currLoop, __visitedBlocks);
-        for(auto &b : tmp) funcLoopOrderBlocks.push_back(funcBlocks[b]);
-      } else {
-        __visitedBlocks.push_back(block.index());
-        funcLoopOrderBlocks.push_back(block.value());
+    auto loopName = loops.back().name;
+    const auto &sameLoopBlocks = innermostLoopBlocks[loopName];
+    for (auto it = std::upper_bound(sameLoopBlocks.begin(), sameLoopBlocks.end(), idx); it != sameLoopBlocks.end(); it++) {
+      auto pseudoBlock = funcBlocks[*it];
+      pseudoBlock.block_type = BlockInfo::BLOCK_TYPE_PSEUDOLOOP;
+      laidOutIndex.push_back(blockIndex[*it]);
+      laidOutBlocks.push_back(std::move(pseudoBlock));
+      if (laidOutBlocks.back().loops.back().loopCount == laidOutBlocks.back().loops.back().loopTotal) {
+        break;
       }
     }
+    processed_loops.insert(std::move(loopName));
+    afterPseudoBlocks = true;
+  }
+  funcBlocks = std::move(laidOutBlocks);
+  blockIndex = std::move(laidOutIndex);
+
+  // Loop Order blocks. The items of each loop are the blocks directly in it and,
+  // at the first block of each inner loop, that inner loop.
+  auto functionItems = vector<LoopItem>();
+  auto loopItems = unordered_map<const LoopBlocks *, vector<LoopItem>>();
+  auto placedLoops = std::unordered_set<const LoopBlocks *>();
+  auto innerLoopOf = [&blockIndex](const vector<LoopBlocks> &loops, const unsigned int position) -> const LoopBlocks * {
+    auto it = std::find_if(loops.begin(), loops.end(), [&](const LoopBlocks &l) {
+      return l.contains[blockIndex[position]];
+    });
+    return it != loops.end() ? &*it : nullptr;
+  };
+  for (unsigned int i = 0; i < funcBlocks.size(); i++) {
+    auto loop = innerLoopOf(loopBlocks, i);
+    if (funcBlocks[i].loops.size() > 0 && !loop) continue;
+    auto *items = &functionItems;
+    for (; loop; loop = innerLoopOf(loop->loops, i)) {
+      if (placedLoops.insert(loop).second) items->emplace_back(loop, 0);
+      items = &loopItems[loop];
+    }
+    items->emplace_back(nullptr, i);
+  }
+  auto loopOrder = layoutLoopItems(functionItems, nullptr, loopItems, blockIndex);
+
+  // leave out normal blocks if there is a pseudo block of them
+  auto pseudoBlockNames = std::unordered_set<string>();
+  for (const auto b : loopOrder)
+    if (funcBlocks[b].block_type == BlockInfo::BLOCK_TYPE_PSEUDOLOOP) pseudoBlockNames.insert(funcBlocks[b].name);
+  auto funcLoopOrderBlocks = vector<BlockInfo>(); funcLoopOrderBlocks.reserve(loopOrder.size());
+  for (const auto b : loopOrder) {
+    if (funcBlocks[b].block_type == BlockInfo::BLOCK_TYPE_NORMAL && pseudoBlockNames.count(funcBlocks[b].name))
+      continue;
+    funcLoopOrderBlocks.push_back(funcBlocks[b]);
+  }
 
-    // remove normal blocks if there is a pseudo block
-    auto it = funcLoopOrderBlocks.begin();
-    while(it != funcLoopOrderBlocks.end()) {
-      if(it->block_type == BlockInfo::BLOCK_TYPE_PSEUDOLOOP) {
-        // look for all the blocks with the same name and remove them from the beginning
-        auto blockName = it->name;
-        auto it2 = funcLoopOrderBlocks.begin();
-        while(it2 != funcLoopOrderBlocks.end()) {
-          if(it2->name == blockName && it2->block_type == BlockInfo::BLOCK_TYPE_NORMAL) {
-            it2 = funcLoopOrderBlocks.erase(it2);
-          } else {
-            it2++;
-          }
-        }
+  result.addressOrderBlocks = std::move(funcBlocks);
+  result.loopOrderBlocks = std::move(funcLoopOrderBlocks);
+  result.functionInfo = std::move(funcInfo);
+  return result;
+}
+
+// The binary-wide result. Function results are added in function order.
+struct AssemblyResult {
+  vector<BlockInfo> addressOrderBlocks;
+  vector<BlockInfo> loopOrderBlocks;
+  unordered_map<string, map<int, vector<unsigned long>>> correspondences;
+  set<string> sourceFiles;
+  vector<FunctionInfo> functionInfos;
+  vector<size_t> functionBlockEnds; // loop order position after the blocks of each function
+  unordered_map<std::string, std::map<int, std::unordered_set<SourceCodeTags>>> sourceCodeInfo;
+
+  void add(FunctionAnalysis &&analysis) {
+    auto &funcBlocks = analysis.addressOrderBlocks;
+    loopOrderBlocks.insert(loopOrderBlocks.end(), make_move_iterator(analysis.loopOrderBlocks.begin()), make_move_iterator(analysis.loopOrderBlocks.end()));
+    functionBlockEnds.push_back(loopOrderBlocks.size());
+
+    mergeMemoryOrder(funcBlocks);
+
+    for (auto &[sourceFile, lines] : analysis.correspondences) {
+      auto &fileCorrespondences = correspondences[sourceFile];
+      for (auto &[line, lineAddresses] : lines) {
+        auto &merged = fileCorrespondences[line];
+        merged.insert(merged.end(), lineAddresses.begin(), lineAddresses.end());
       }
-      it++;
     }
-    // move all funcLoopOrderBlocks to loopOrderBlocks
-    loopOrderBlocks.insert(loopOrderBlocks.end(), make_move_iterator(funcLoopOrderBlocks.begin()), make_move_iterator(funcLoopOrderBlocks.end()));
-    
-    auto blockI = std::find_if(addressOrderBlocks.begin(), addressOrderBlocks.end(), [&funcBlocks](const BlockInfo &b) {
-      return funcBlocks.front().startAddress < b.startAddress;
-    });
-    addressOrderBlocks.insert(blockI, make_move_iterator(funcBlocks.begin()), make_move_iterator(funcBlocks.end()));
-    
-    functionInfos.push_back(std::move(funcInfo));
+    for (auto &[sourceFile, lines] : analysis.sourceCodeInfo) {
+      auto &fileInfo = sourceCodeInfo[sourceFile];
+      for (auto &[line, tags] : lines) fileInfo[line].insert(tags.begin(), tags.end());
+    }
+    for (const auto file : analysis.sourceFiles) sourceFiles.insert(*file);
 
-    
-    
-    bar.tick();
+    functionInfos.push_back(std::move(analysis.functionInfo));
+  }
 
+ private:
+  // The memory order is sorted by unit start, a unit being a normal block and the
+  // pseudo blocks laid out after it. Equal starts keep function order.
+  static int unitStart(const vector<BlockInfo> &blocks, size_t i) {
+    while (i > 0 && blocks[i].block_type == BlockInfo::BLOCK_TYPE_PSEUDOLOOP) i--;
+    return blocks[i].startAddress;
   }
-  return {addressOrderBlocks, loopOrderBlocks, source_correspondences, unique_sourcefiles, functionInfos, sourceCodeInfo};
-}
 
-auto binaryCacheResult = map<string, BinaryCacheResult*>();
+  static size_t unitEnd(const vector<BlockInfo> &blocks, size_t i) {
+    for (i++; i < blocks.size() && blocks[i].block_type == BlockInfo::BLOCK_TYPE_PSEUDOLOOP; i++);
+    return i;
+  }
 
-bool isParsable(const string &binaryPath) {
-  SymtabAPI::Symtab *symtab;
-  return SymtabAPI::Symtab::openFile(symtab, binaryPath);
-}
+  // Merges the units of a function, already sorted, into the memory order. Functions
+  // come in entry order, so only a short tail of the memory order is usually merged.
+  void mergeMemoryOrder(vector<BlockInfo> &funcBlocks) {
+    if (funcBlocks.empty()) return;
+
+    // The first unit starting after the function's first block
+    auto lo = size_t(0), hi = addressOrderBlocks.size();
+    while (lo < hi) {
+      auto mid = lo + (hi - lo) / 2;
+      if (unitStart(addressOrderBlocks, mid) <= funcBlocks.front().startAddress) lo = mid + 1;
+      else hi = mid;
+    }
+    auto tail = vector<BlockInfo>(make_move_iterator(addressOrderBlocks.begin() + lo), make_move_iterator(addressOrderBlocks.end()));
+    addressOrderBlocks.erase(addressOrderBlocks.begin() + lo, addressOrderBlocks.end());
+    addressOrderBlocks.reserve(addressOrderBlocks.size() + tail.size() + funcBlocks.size());
+
+    auto i = size_t(0), j = size_t(0);
+    while (i < tail.size() || j < funcBlocks.size()) {
+      auto fromTail = j == funcBlocks.size() ||
+                      (i < tail.size() && tail[i].startAddress <= funcBlocks[j].startAddress);
+      auto &blocks = fromTail ? tail : funcBlocks;
+      auto &k = fromTail ? i : j;
+      auto end = unitEnd(blocks, k);
+      addressOrderBlocks.insert(addressOrderBlocks.end(), make_move_iterator(blocks.begin() + k), make_move_iterator(blocks.begin() + end));
+      k = end;
+    }
+  }
+};
 
+// functionsDone, when given, counts the analyzed functions for AnalysisStatus
+AssemblyResult getAssembly(const vector<ParseAPI::Function *> &funcList, AnalysisContext &ctx, unsigned int nThreads,
+                           std::atomic<size_t> *functionsDone = nullptr) {
 
+  auto bar = indicators::ProgressBar{
+    indicators::option::BarWidth{50},
+    indicators::option::MaxProgress{funcList.size()},
+    indicators::option::Start{" ["},
+    indicators::option::Fill{"█"},
+    indicators::option::Lead{"█"},
+    indicators::option::Remainder{"-"},
+    indicators::option::End{"]"},
+    indicators::option::PrefixText{"Disassembling"},
+    indicators::option::ForegroundColor{indicators::Color::yellow},
+    indicators::option::ShowElapsedTime{true},
+    indicators::option::ShowRemainingTime{true},
+    indicators::option::FontStyles{std::vector<indicators::FontStyle>{indicators::FontStyle::bold}}
+  };
 
-BinaryCacheResult* decodeBinaryCache(const string binaryPath, const bool saveJson) {
-  if (binaryCacheResult.find(binaryPath) != binaryCacheResult.end()) return binaryCacheResult.at(binaryPath);
+  auto assembly = AssemblyResult();
 
-  SymtabAPI::Symtab *symtab;
-  auto isParsable = SymtabAPI::Symtab::openFile(symtab, binaryPath);
-  if (!isParsable) {
-    std::cerr << "Error: file " << binaryPath << " can not be parsed" << std::endl;
-    return nullptr;
+  if (nThreads == 0) nThreads = std::thread::hardware_concurrency();
+  const auto nWorkers = std::max(1u, std::min<unsigned int>(nThreads, funcList.size()));
+
+  // create an Instruction decoder per worker which will convert the binary opcodes to strings
+  auto decoders = vector<InstructionAPI::InstructionDecoder>();
+  for (unsigned int w = 0; w < nWorkers; w++) decoders.push_back(makeDecoder(funcList.front()));
+
+  // Decode every instruction once into the instruction table. This is needed before the functions are analyzed to get all addresses first
+  auto workerInstructions = vector<vector<DecodedInstruction>>(nWorkers);
+  auto workerSourceFiles = vector<std::unordered_set<const string *>>(nWorkers);
+  parallelFor(ctx.blocks.size(), nWorkers, [&](const size_t i, const unsigned int w) {
+    decodeBlock(ctx.lineTable, decoders[w], ctx.blocks[i].first, ctx.blocks[i].second, workerInstructions[w], workerSourceFiles[w]);
+  });
+  for (unsigned int w = 0; w < nWorkers; w++) {
+    ctx.instructions.insert(ctx.instructions.end(), make_move_iterator(workerInstructions[w].begin()), make_move_iterator(workerInstructions[w].end()));
+    for (const auto file : workerSourceFiles[w]) assembly.sourceFiles.insert(*file);
   }
-  auto sts = std::make_unique<ParseAPI::SymtabCodeSource>(const_cast<char *>(binaryPath.c_str()));
-  auto co = std::make_unique<ParseAPI::CodeObject>(sts.get());
-  co->parse();
+  workerInstructions.clear();
+  sortInstructions(ctx.instructions);
 
-  auto funcs = co->funcs();
-  if (funcs.empty()) {
-    std::cerr << "Error: no functions in file" << std::endl;
-    return nullptr;
+  auto analyses = vector<FunctionAnalysis>(funcList.size());
+  parallelFor(funcList.size(), nWorkers, [&](const size_t i, const unsigned int w) {
+    analyses[i] = analyzeFunction(ctx, funcList[i], i, decoders[w]);
+    bar.tick();
+    if (functionsDone) (*functionsDone)++;
+  });
+
+  // Merge in function order so the result does not depend on the number of workers
+  for (auto &analysis : analyses) {
+    assembly.add(std::move(analysis));
+    analysis = FunctionAnalysis();
+  }
+  return assembly;
+}
+
+BlockIndex makeBlockIndex(const vector<BlockInfo> &blocks) {
+  auto index = BlockIndex();
+  index.by_address.reserve(blocks.size());
+  index.by_id.reserve(blocks.size());
+  for (unsigned int i = 0; i < blocks.size(); i++) {
+    index.by_address.emplace_back(blocks[i].startAddress, i);
+    index.by_id.emplace(blocks[i].name, i);
+  }
+  std::sort(index.by_address.begin(), index.by_address.end());
+  return index;
+}
+
+// Instructions of a bucket holding each INSTRUCTION_FLAGS
+int dominantType(const InstructionFlagCounts &counts) {
+  auto dominant = std::max_element(counts.begin(), counts.end());
+  return *dominant > 0 ? int(dominant - counts.begin()) : -1;
+}
+
+vector<MinimapLevel> makeMinimapLevels(const vector<BlockInfo> &blocks, const MinimapInfo &minimap) {
+  auto levels = vector<MinimapLevel>();
+  if (blocks.empty()) return levels;
+
+  // Level 0 comes from the block summaries. Pseudo blocks repeat blocks laid out
+  // elsewhere, so like their instructions their flags and built-in state are not counted.
+  auto level = MinimapLevel{1};
+  auto counts = vector<InstructionFlagCounts>();
+  counts.reserve(blocks.size());
+  for (size_t i = 0; i < blocks.size(); i++) {
+    const auto normal = blocks[i].block_type == BlockInfo::BLOCK_TYPE_NORMAL;
+    counts.push_back(normal ? blocks[i].flagCounts : InstructionFlagCounts{});
+    level.start_address.push_back(minimap.block_start_address[i]);
+    level.instructions.push_back(minimap.block_heights[i]);
+    level.built_in_blocks.push_back(normal && minimap.built_in_blocks[i]);
+    level.loop_depth.push_back(minimap.block_loop_indents[i]);
+    level.type_bits.push_back(normal ? blocks[i].flags.bits : 0);
+    level.dominant_type.push_back(dominantType(counts.back()));
+  }
+  levels.push_back(std::move(level));
+
+  while (levels.back().start_address.size() > 1) {
+    const auto &finer = levels.back();
+    const auto n = finer.start_address.size();
+    const auto nBuckets = (n + MINIMAP_LEVEL_FACTOR - 1) / MINIMAP_LEVEL_FACTOR;
+    auto coarser = MinimapLevel{finer.bucket_blocks * MINIMAP_LEVEL_FACTOR};
+    auto coarserCounts = vector<InstructionFlagCounts>(nBuckets);
+    for (size_t b = 0; b < nBuckets; b++) {
+      auto instructions = 0, builtIn = 0, depth = 0, bits = 0;
+      for (auto k = b * MINIMAP_LEVEL_FACTOR; k < std::min(n, (b + 1) * MINIMAP_LEVEL_FACTOR); k++) {
+        instructions += finer.instructions[k];
+        builtIn += finer.built_in_blocks[k];
+        depth = std::max(depth, finer.loop_depth[k]);
+        bits |= finer.type_bits[k];
+        for (int flag = INST_VECTORIZED; flag <= INST_FP; flag++) coarserCounts[b][flag] += counts[k][flag];
+      }
+      coarser.start_address.push_back(finer.start_address[b * MINIMAP_LEVEL_FACTOR]);
+      coarser.instructions.push_back(instructions);
+      coarser.built_in_blocks.push_back(builtIn);
+      coarser.loop_depth.push_back(depth);
+      coarser.type_bits.push_back(bits);
+      coarser.dominant_type.push_back(dominantType(coarserCounts[b]));
+    }
+    counts = std::move(coarserCounts);
+    levels.push_back(std::move(coarser));
   }
+  return levels;
+}
+
+void indexBlocks(BinaryCacheResult &res) {
+  res.block_index.memory_order = makeBlockIndex(res.disassembly.memory_order_blocks);
+  res.block_index.loop_order = makeBlockIndex(res.disassembly.loop_order_blocks);
+  res.minimap_levels.memory_order = makeMinimapLevels(res.disassembly.memory_order_blocks, res.minimap.memory_order);
+  res.minimap_levels.loop_order = makeMinimapLevels(res.disassembly.loop_order_blocks, res.minimap.loop_order);
+  res.block_json.memory_order.assign(res.disassembly.memory_order_blocks.size(), string());
+  res.block_json.loop_order.assign(res.disassembly.loop_order_blocks.size(), string());
+}
 
-  auto [addressOrderBlocks, loopOrderBlocks, correspondence, unique_sourcefiles, functionInfos, sourceCodeInfo] = getAssembly(symtab, funcs);
+std::shared_ptr<BinaryCacheResult> makeBinaryCacheResult(AssemblyResult &assembly, const uint64_t binaryHash) {
+  // The orders are independent, so the loop order minimap is built on another thread
+  auto loopOrderMinimap = std::async(std::launch::async, [&assembly] { return makeMinimapInfo(assembly.loopOrderBlocks); });
+  auto minimap = decltype(BinaryCacheResult::minimap){makeMinimapInfo(assembly.addressOrderBlocks), loopOrderMinimap.get()};
 
   // std::cout << "Total Loops: " << totalLoops << std::endl;
-  auto source_files = vector<string>(unique_sourcefiles.begin(),
-                                        unique_sourcefiles.end());
-  
-  binaryCacheResult[binaryPath] = new BinaryCacheResult({
-      {addressOrderBlocks, loopOrderBlocks},
-      {{
-        getBlockHeights(addressOrderBlocks),
-        getIsBuiltInBlock(addressOrderBlocks),
-        getBlockStartAddresses(addressOrderBlocks),
-        getBlockIndents(addressOrderBlocks),
-        getBlockTypes(addressOrderBlocks),
-      }, {
-        getBlockHeights(loopOrderBlocks),
-        getIsBuiltInBlock(loopOrderBlocks),
-        getBlockStartAddresses(loopOrderBlocks),
-        getBlockIndents(loopOrderBlocks),
-        getBlockTypes(addressOrderBlocks),
-      }},
+  auto source_files = vector<string>(assembly.sourceFiles.begin(),
+                                        assembly.sourceFiles.end());
+
+  auto res = std::make_shared<BinaryCacheResult>(BinaryCacheResult{
+      {std::move(assembly.addressOrderBlocks), std::move(assembly.loopOrderBlocks)},
+      std::move(minimap),
       source_files,
-      correspondence,
-      sourceCodeInfo
+      std::move(assembly.correspondences),
+      std::move(assembly.sourceCodeInfo)
   });
+  indexBlocks(*res);
+  res->binary_hash = binaryHash;
+  return res;
+}
+
+// Estimated heap bytes owned by a result, for AnalysisOptions::cacheMemoryLimit.
+// Container nodes are counted with a typical overhead of a few pointers.
+#define MAP_NODE_BYTES (4 * sizeof(void *))
+#define HASH_NODE_BYTES (2 * sizeof(void *))
+
+size_t heapBytes(const string &s) { return s.capacity() > 15 ? s.capacity() + 1 : 0; }
+template <typename T> requires std::is_trivially_destructible_v<T> size_t heapBytes(const T &) { return 0; }
+template <typename T> size_t heapBytes(const vector<T> &v);
+template <typename K, typename V> size_t heapBytes(const map<K, V> &m);
+template <typename K, typename V> size_t heapBytes(const unordered_map<K, V> &m);
+template <typename T> size_t heapBytes(const std::unordered_set<T> &s);
+
+size_t heapBytes(const vector<bool> &v) { return v.capacity() / 8; }
+size_t heapBytes(const VarLocation &l) { return heapBytes(l.location); }
+size_t heapBytes(const VariableInfo &v) { return heapBytes(v.name) + heapBytes(v.file) + heapBytes(v.locations); }
+size_t heapBytes(const InstructionInfo &i) { return heapBytes(i.instruction) + heapBytes(i.correspondence) + heapBytes(i.variables); }
+size_t heapBytes(const BlockLoopState &l) { return heapBytes(l.name); }
+size_t heapBytes(const Hidable &h) { return heapBytes(h.name); }
+
+size_t heapBytes(const BlockInfo &b) {
+  return heapBytes(b.name) + heapBytes(b.instructions) + heapBytes(b.functionName) + heapBytes(b.nextBlockNames) +
+         heapBytes(b.loops) + heapBytes(b.backedges) + heapBytes(b.hidables);
+}
+
+size_t heapBytes(const MinimapInfo &m) {
+  return heapBytes(m.block_heights) + heapBytes(m.built_in_blocks) + heapBytes(m.block_start_address) +
+         heapBytes(m.block_loop_indents) + heapBytes(m.block_types);
+}
+
+size_t heapBytes(const MinimapLevel &l) {
+  return heapBytes(l.start_address) + heapBytes(l.instructions) + heapBytes(l.built_in_blocks) +
+         heapBytes(l.loop_depth) + heapBytes(l.type_bits) + heapBytes(l.dominant_type);
+}
+
+size_t heapBytes(const BlockIndex &index) { return heapBytes(index.by_address) + heapBytes(index.by_id); }
+
+template <typename T> size_t heapBytes(const vector<T> &v) {
+  auto bytes = v.capacity() * sizeof(T);
+  if constexpr (!std::is_trivially_destructible_v<T>)
+    for (const auto &x : v) bytes += heapBytes(x);
+  return bytes;
+}
+
+template <typename K, typename V> size_t heapBytes(const map<K, V> &m) {
+  auto bytes = m.size() * (MAP_NODE_BYTES + sizeof(std::pair<const K, V>));
+  for (const auto &[key, value] : m) bytes += heapBytes(key) + heapBytes(value);
+  return bytes;
+}
+
+template <typename K, typename V> size_t heapBytes(const unordered_map<K, V> &m) {
+  auto bytes = m.size() * (HASH_NODE_BYTES + sizeof(std::pair<const K, V>)) + m.bucket_count() * sizeof(void *);
+  for (const auto &[key, value] : m) bytes += heapBytes(key) + heapBytes(value);
+  return bytes;
+}
+
+template <typename T> size_t heapBytes(const std::unordered_set<T> &s) {
+  return s.size() * (HASH_NODE_BYTES + sizeof(T)) + s.bucket_count() * sizeof(void *);
+}
+
+// The serialized blocks in block_json are filled on first use and counted by addResultBytes
+size_t resultBytes(const BinaryCacheResult &res) {
+  return sizeof(res) + heapBytes(res.disassembly.memory_order_blocks) + heapBytes(res.disassembly.loop_order_blocks) +
+         heapBytes(res.minimap.memory_order) + heapBytes(res.minimap.loop_order) + heapBytes(res.source_files) +
+         heapBytes(res.correspondences) + heapBytes(res.sourceCodeInfo) + heapBytes(res.block_index.memory_order) +
+         heapBytes(res.block_index.loop_order) + heapBytes(res.minimap_levels.memory_order) +
+         heapBytes(res.minimap_levels.loop_order) + heapBytes(res.block_json.memory_order) + heapBytes(res.block_json.loop_order);
+}
+
+// Finished results, shared by the server threads. Lookups take cacheMutex shared and
+// it is only held exclusively to insert.
+// Once the results exceed AnalysisOptions::cacheMemoryLimit the least recently used are
+// evicted. Requests that still use an evicted result keep it alive until they finish.
+struct CachedResult {
+  std::shared_ptr<BinaryCacheResult> result;
+  size_t bytes;
+  std::list<string>::iterator position;
+};
+auto binaryCacheResult = map<string, CachedResult>();
+auto recentResults = std::list<string>(); // most recently used first
+auto cachedBytes = size_t(0);
+std::shared_mutex cacheMutex;
+std::mutex recentMutex; // guards recentResults while cacheMutex is held shared
+// Dyninst opens, parses and closes one binary at a time. Cache loads and the analyses
+// of parsed binaries run concurrently.
+std::mutex parseMutex;
+auto analysisOptions = AnalysisOptions();
+
+std::shared_ptr<BinaryCacheResult> findResult(const string &binaryPath) {
+  auto lock = std::shared_lock(cacheMutex);
+  auto it = binaryCacheResult.find(binaryPath);
+  if (it == binaryCacheResult.end()) return nullptr;
+  auto recentLock = std::lock_guard(recentMutex);
+  recentResults.splice(recentResults.begin(), recentResults, it->second.position);
+  return it->second.result;
+}
+
+void storeResult(const string &binaryPath, std::shared_ptr<BinaryCacheResult> res);
+
+void setAnalysisOptions(const AnalysisOptions &options) {
+  analysisOptions = options;
+}
+
+bool isParsable(const string &binaryPath) {
+  auto parseLock = std::lock_guard(parseMutex);
+  // openFile shares the Symtab of an open file, which is in use and must stay open
+  if (SymtabAPI::Symtab::findOpenSymtab(binaryPath)) return true;
+  SymtabAPI::Symtab *symtab;
+  if (!SymtabAPI::Symtab::openFile(symtab, binaryPath)) return false;
+  SymtabAPI::Symtab::closeSymtab(symtab);
+  return true;
+}
+
+// Writes the on-disk cache entry and, with --save-json, the JSON export of a finished analysis
+void saveAnalysisOutputs(const string &binaryPath, const std::shared_ptr<BinaryCacheResult> &res, const AssemblyResult &assembly,
+                         const bool saveJson, const uint64_t binaryHash) {
+  if (!analysisOptions.cacheDir.empty() && !saveAnalysisCache(analysisOptions.cacheDir, binaryHash, *res))
+    std::cerr << "Warning: could not save the analysis cache of " << binaryPath << std::endl;
   
   if(saveJson) {
-    auto jsonName = binaryPath.substr(binaryPath.find_last_of("/\\") + 1) + ".json";
+    auto jsonName = binaryPath.substr(binaryPath.find_last_of("/\\") + 1) + (analysisOptions.jsonLines ? ".jsonl" : ".json");
 
     auto path = std::filesystem::current_path() / "json";
     if(!std::filesystem::is_directory(path) || !std::filesystem::exists(path)) {
@@ -939,13 +1378,664 @@ BinaryCacheResult* decodeBinaryCache(const string binaryPath, const bool saveJso
     }
     path /= jsonName;
     auto o = std::ofstream(path.string());
-    auto j = crow::json::wvalue();
-    j["blocks_info"] = convertBinaryCache(binaryCacheResult[binaryPath]);
-    
-    j["functions"] = convertFunctionInfos(functionInfos);
-    
-    o << j.dump() << std::endl;
+    if (analysisOptions.jsonLines)
+      writeBinaryJsonLines(o, res.get(), assembly.functionInfos, assembly.functionBlockEnds);
+    else
+      writeBinaryJson(o, res.get(), assembly.functionInfos);
+    if (!o) std::cerr << "Warning: could not write " << path.string() << std::endl;
   }
-  
-  return binaryCacheResult[binaryPath];
-}
\ No newline at end of file
+}
+
+// Loads binaryPath from the on-disk cache into binaryCacheResult. The hash
+// of the binary is returned in binaryHash for the result of a new analysis.
+bool loadCachedBinary(const string &binaryPath, const bool saveJson, uint64_t &binaryHash) {
+  binaryHash = hashBinaryContents(binaryPath);
+  if (analysisOptions.cacheDir.empty()) return false;
+  // The on-disk cache has no FunctionInfo, so --save-json always runs the analysis
+  if (saveJson) return false;
+  auto cached = std::make_shared<BinaryCacheResult>();
+  if (!loadAnalysisCache(analysisOptions.cacheDir, binaryHash, *cached)) return false;
+  indexBlocks(*cached);
+  cached->binary_hash = binaryHash;
+  storeResult(binaryPath, std::move(cached));
+  return true;
+}
+
+struct SymtabCloser {
+  void operator()(SymtabAPI::Symtab *symtab) const {
+    auto parseLock = std::lock_guard(parseMutex);
+    SymtabAPI::Symtab::closeSymtab(symtab);
+  }
+};
+
+// The code source does not own the symtab, which is closed after everything parsed from it
+struct ParsedBinary {
+  unique_ptr<SymtabAPI::Symtab, SymtabCloser> symtab;
+  unique_ptr<ParseAPI::SymtabCodeSource> sts;
+  unique_ptr<ParseAPI::CodeObject> co;
+};
+
+bool parseBinary(const string &binaryPath, ParsedBinary &parsed) {
+  SymtabAPI::Symtab *symtab;
+  auto isParsable = SymtabAPI::Symtab::openFile(symtab, binaryPath);
+  if (!isParsable) {
+    std::cerr << "Error: file " << binaryPath << " can not be parsed" << std::endl;
+    return false;
+  }
+  parsed.symtab.reset(symtab);
+  parsed.sts = std::make_unique<ParseAPI::SymtabCodeSource>(symtab);
+  parsed.co = std::make_unique<ParseAPI::CodeObject>(parsed.sts.get());
+  parsed.co->parse();
+
+  if (parsed.co->funcs().empty()) {
+    std::cerr << "Error: no functions in file" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+const vector<BlockInfo> &orderBlocks(const BinaryCacheResult *res, const BLOCK_ORDER order) {
+  return order == MEMORY_ORDER ? res->disassembly.memory_order_blocks : res->disassembly.loop_order_blocks;
+}
+
+vector<string> &orderJson(const BinaryCacheResult *res, const BLOCK_ORDER order) {
+  return order == MEMORY_ORDER ? res->block_json.memory_order : res->block_json.loop_order;
+}
+
+const BlockIndex &orderIndex(const BinaryCacheResult *res, const BLOCK_ORDER order) {
+  return order == MEMORY_ORDER ? res->block_index.memory_order : res->block_index.loop_order;
+}
+
+// Position of the first block in the order starting at address, or the number of blocks
+size_t findBlockStartingAt(const BinaryCacheResult *res, const BLOCK_ORDER order, const unsigned long address) {
+  const auto &index = orderIndex(res, order).by_address;
+  if (address > (unsigned long)std::numeric_limits<int>::max()) return index.size();
+  auto it = std::lower_bound(index.begin(), index.end(), std::make_pair((int)address, 0u));
+  return it != index.end() && it->first == (int)address ? it->second : index.size();
+}
+
+// Position of the block containing address, or the number of blocks. Blocks do not
+// overlap, so it is the first block in the order among those starting closest before address.
+size_t findBlockAt(const BinaryCacheResult *res, const BLOCK_ORDER order, const unsigned long address) {
+  const auto &index = orderIndex(res, order).by_address;
+  const auto &blocks = orderBlocks(res, order);
+  if (address > (unsigned long)std::numeric_limits<int>::max()) return index.size();
+  auto end = std::upper_bound(index.begin(), index.end(), std::make_pair((int)address, std::numeric_limits<unsigned int>::max()));
+  if (end == index.begin()) return index.size();
+  auto it = std::lower_bound(index.begin(), end, std::make_pair(std::prev(end)->first, 0u));
+  for (; it != end; it++)
+    if (blocks[it->second].endAddress >= (int)address) return it->second;
+  return index.size();
+}
+
+bool getMinimapTile(const BinaryCacheResult &res, const BLOCK_ORDER order, size_t startBlock, size_t endBlock,
+                    const size_t maxBuckets, MinimapTile &tile) {
+  const auto &levels = order == MEMORY_ORDER ? res.minimap_levels.memory_order : res.minimap_levels.loop_order;
+  if (levels.empty()) return false;
+  const auto nBlocks = levels.front().start_address.size();
+  endBlock = std::clamp(endBlock, size_t(1), nBlocks);
+  startBlock = std::min(startBlock, endBlock - 1);
+  // The last level has a single bucket, so it always fits
+  for (size_t l = 0; l < levels.size(); l++) {
+    const auto bucketBlocks = size_t(levels[l].bucket_blocks);
+    tile = {&levels[l], int(l), startBlock / bucketBlocks, (endBlock + bucketBlocks - 1) / bucketBlocks};
+    if (tile.endBucket - tile.startBucket <= std::max(maxBuckets, size_t(1))) break;
+  }
+  return true;
+}
+
+void getBlockRange(const BinaryCacheResult &res, const BLOCK_ORDER order, const unsigned long startAddress,
+                   const unsigned long endAddress, size_t &startBlock, size_t &endBlock) {
+  const auto &index = orderIndex(&res, order).by_address;
+  if (index.empty()) {
+    startBlock = endBlock = 0;
+    return;
+  }
+  const auto clamped = [](const unsigned long address) { return (int)std::min<unsigned long>(address, std::numeric_limits<int>::max()); };
+  // The block containing startAddress, else the first block starting after it
+  auto first = findBlockAt(&res, order, startAddress);
+  if (first == index.size()) {
+    auto it = std::lower_bound(index.begin(), index.end(), std::make_pair(clamped(startAddress), 0u));
+    first = (it != index.end() ? it : std::prev(it))->second;
+  }
+  // The last block starting at or before endAddress
+  auto it = std::upper_bound(index.begin(), index.end(), std::make_pair(clamped(endAddress), std::numeric_limits<unsigned int>::max()));
+  auto last = size_t((it != index.begin() ? std::prev(it) : it)->second);
+  // Loop order is not sorted by address
+  startBlock = std::min(first, last);
+  endBlock = std::max(first, last) + 1;
+}
+
+// The page of a finished analysis starting at start, a view into the blocks
+// of the order and their serialized json
+bool pageAt(const std::shared_ptr<BinaryCacheResult> &res, const BLOCK_ORDER order, const size_t start, DisassemblyPage &page) {
+  const auto &blocks = orderBlocks(res.get(), order);
+  auto &json = orderJson(res.get(), order);
+  if (start >= blocks.size()) return false;
+  auto end = std::min(start + BLOCKS_PER_PAGE, blocks.size());
+  page.storage.clear();
+  page.blocks = std::span(blocks.begin() + start, blocks.begin() + end);
+  page.json = std::span(json.begin() + start, json.begin() + end);
+  page.pageNo = start / BLOCKS_PER_PAGE;
+  page.isLast = end >= blocks.size();
+  page.binaryHash = res->binary_hash;
+  page.result = res;
+  return true;
+}
+
+// The page starting at start of an order still being merged. Its blocks are copied
+// since the order keeps growing, and it is never the last page.
+bool partialPageAt(const vector<BlockInfo> &blocks, const size_t start, DisassemblyPage &page) {
+  if (start >= blocks.size()) return false;
+  auto end = std::min(start + BLOCKS_PER_PAGE, blocks.size());
+  page.storage.assign(blocks.begin() + start, blocks.begin() + end);
+  page.blocks = page.storage;
+  page.json = {};
+  page.pageNo = start / BLOCKS_PER_PAGE;
+  page.isLast = false;
+  page.binaryHash = 0;
+  page.result = nullptr;
+  return true;
+}
+
+// Index of the first block in [from, to) that contains address, or to
+size_t findBlockContaining(const vector<BlockInfo> &blocks, size_t from, const size_t to, const unsigned long address) {
+  for (; from < to; from++) {
+    if (blocks[from].startAddress <= address && blocks[from].endAddress >= address) break;
+  }
+  return from;
+}
+
+bool resultPageByAddress(const std::shared_ptr<BinaryCacheResult> &res, const BLOCK_ORDER order, const unsigned long address, DisassemblyPage &page) {
+  const auto &blocks = orderBlocks(res.get(), order);
+  auto position = findBlockAt(res.get(), order, address);
+  // An address outside every block shows the first page
+  return pageAt(res, order, position < blocks.size() ? position / BLOCKS_PER_PAGE * BLOCKS_PER_PAGE : 0, page);
+}
+
+void resultBlockAt(const std::shared_ptr<BinaryCacheResult> &res, const BLOCK_ORDER order, const size_t position, DisassemblyBlock &block) {
+  block.block = &orderBlocks(res.get(), order)[position];
+  block.json = &orderJson(res.get(), order)[position];
+  block.binaryHash = res->binary_hash;
+  block.result = res;
+}
+
+// Copies a block of an analysis still in progress into block
+void copiedBlock(const BlockInfo &info, DisassemblyBlock &block) {
+  block.storage = info;
+  block.block = &block.storage;
+  block.json = nullptr;
+  block.binaryHash = 0;
+  block.result = nullptr;
+}
+
+bool resultBlockByAddress(const std::shared_ptr<BinaryCacheResult> &res, const BLOCK_ORDER order, const unsigned long address, DisassemblyBlock &block) {
+  auto position = findBlockStartingAt(res.get(), order, address);
+  if (position == orderBlocks(res.get(), order).size()) return false;
+  resultBlockAt(res, order, position, block);
+  return true;
+}
+
+bool resultBlockById(const std::shared_ptr<BinaryCacheResult> &res, const BLOCK_ORDER order, const string &id, DisassemblyBlock &block) {
+  const auto &index = orderIndex(res.get(), order).by_id;
+  auto it = index.find(id);
+  if (it == index.end()) return false;
+  resultBlockAt(res, order, it->second, block);
+  return true;
+}
+
+// The background analysis of one binary, shared by every caller that asks for it
+struct AnalysisJob {
+  std::atomic<size_t> functionsDone = 0;
+
+  void update(const ANALYSIS_PHASE newPhase, const bool isQueryable) {
+    {
+      auto lock = std::lock_guard(m);
+      phase = newPhase;
+      queryable = isQueryable;
+    }
+    cv.notify_all();
+  }
+
+  void setFunctionsTotal(const size_t total) {
+    auto lock = std::lock_guard(m);
+    functionsTotal = total;
+  }
+
+  AnalysisStatus status() {
+    auto lock = std::lock_guard(m);
+    return {phase, functionsDone, functionsTotal, queryable};
+  }
+
+  // Waits until the job is finished or, unless untilDone, queryable. False if it failed.
+  bool wait(const bool untilDone) {
+    auto lock = std::unique_lock(m);
+    cv.wait(lock, [&] { return phase == PHASE_DONE || phase == PHASE_FAILED || (!untilDone && queryable); });
+    return phase != PHASE_FAILED;
+  }
+
+ private:
+  std::mutex m;
+  std::condition_variable cv;
+  ANALYSIS_PHASE phase = PHASE_QUEUED;
+  size_t functionsTotal = 0;
+  bool queryable = false;
+};
+
+// A binary analyzed one function at a time in the background (AnalysisOptions::lazy).
+// Workers take the pending function whose entry is closest to the most recently
+// requested address. Finished functions are merged in function order as soon as
+// every earlier one is done, so the final result is the same as the eager one.
+// Until then, requests are answered from the part of each order that can no
+// longer change.
+class LazyBinary : public std::enable_shared_from_this<LazyBinary> {
+ public:
+  LazyBinary(const string &binaryPath, const bool saveJson, const uint64_t binaryHash, ParsedBinary &&parsed,
+             vector<ParseAPI::Function *> &&functions, AnalysisContext &&context, std::shared_ptr<AnalysisJob> job)
+      : binaryPath(binaryPath), saveJson(saveJson), binaryHash(binaryHash), parsed(std::move(parsed)), job(std::move(job)),
+        funcList(std::move(functions)), ctx(std::move(context)) {
+    results.resize(funcList.size());
+
+    // Memory order blocks are merged by start address, so blocks up to the lowest
+    // start of any unmerged function are final
+    lowestStartAfter.assign(funcList.size() + 1, std::numeric_limits<int>::max());
+    for (size_t i = funcList.size(); i-- > 0;) {
+      auto lowest = std::numeric_limits<int>::max();
+      for (const auto &block : funcList[i]->blocks()) {
+        lowest = std::min(lowest, (int)block->start());
+        blockFunction.emplace(ctx.block_ids.at(block, i), i);
+      }
+      lowestStartAfter[i] = std::min(lowest, lowestStartAfter[i + 1]);
+      functionIndex[funcList[i]] = i;
+    }
+
+    for (size_t i = 0; i < funcList.size(); i++) byEntry.emplace_back(funcList[i]->addr(), i);
+    std::sort(byEntry.begin(), byEntry.end());
+    for (size_t p = 0; p < byEntry.size(); p++) pending.insert(p);
+    hint = byEntry.front().first;
+
+    if (!ctx.blocks.empty()) {
+      rangeStart = ctx.blocks.front().first->start();
+      rangeEnd = ctx.blocks.back().first->last();
+    }
+  }
+
+  void start(unsigned int nWorkers) {
+    if (nWorkers == 0) nWorkers = std::thread::hardware_concurrency();
+    nWorkers = std::max(1u, std::min<unsigned int>(nWorkers, funcList.size()));
+    for (unsigned int w = 0; w < nWorkers; w++)
+      std::thread([self = shared_from_this()]() { self->work(); }).detach();
+  }
+
+  bool page(const BLOCK_ORDER order, const int pageNo, DisassemblyPage &page) {
+    auto lock = std::unique_lock(m);
+    const auto start = size_t(pageNo) * BLOCKS_PER_PAGE;
+    hint = nextToMerge();
+    cv.wait(lock, [&] { return done() || (!finishing && stable[order] >= start + BLOCKS_PER_PAGE); });
+    if (failed) return false;
+    return result ? pageAt(result, order, start, page) : partialPageAt(mergedBlocks(order), start, page);
+  }
+
+  bool pageByAddress(const BLOCK_ORDER order, const unsigned long address, DisassemblyPage &page) {
+    auto lock = std::unique_lock(m);
+    // The function being viewed is analyzed first
+    auto containing = ctx.blockAt(address);
+    hint = containing ? funcList[functionIndex.at(containing->second)]->addr() : nextToMerge();
+    auto scanned = size_t(0);
+    auto found = false;
+    cv.wait(lock, [&] {
+      if (done()) return true;
+      if (finishing) return false;
+      scanned = findBlockContaining(mergedBlocks(order), scanned, stable[order], address);
+      found = scanned < stable[order];
+      return found;
+    });
+    if (failed) return false;
+    if (result) return resultPageByAddress(result, order, address, page);
+    return partialPageAt(mergedBlocks(order), scanned / BLOCKS_PER_PAGE * BLOCKS_PER_PAGE, page);
+  }
+
+  bool blockByAddress(const BLOCK_ORDER order, const unsigned long address, DisassemblyBlock &block) {
+    auto lock = std::unique_lock(m);
+    auto containing = ctx.blockAt(address);
+    if (!containing) return false;
+    auto funcIndex = functionIndex.at(containing->second);
+    hint = address;
+    cv.wait(lock, [&] { return done() || (!finishing && analyzed(funcIndex)); });
+    if (failed) return false;
+    if (result) return resultBlockByAddress(result, order, address, block);
+    auto found = findFunctionBlock(funcIndex, order, [&address](const BlockInfo &b) { return b.startAddress == (int)address; });
+    if (!found) return false;
+    copiedBlock(*found, block);
+    return true;
+  }
+
+  bool blockById(const BLOCK_ORDER order, const string &id, DisassemblyBlock &block) {
+    auto lock = std::unique_lock(m);
+    auto owner = blockFunction.find(id);
+    if (owner == blockFunction.end()) return false;
+    auto funcIndex = owner->second;
+    hint = funcList[funcIndex]->addr();
+    cv.wait(lock, [&] { return done() || (!finishing && analyzed(funcIndex)); });
+    if (failed) return false;
+    if (result) return resultBlockById(result, order, id, block);
+    auto found = findFunctionBlock(funcIndex, order, [&id](const BlockInfo &b) { return b.name == id; });
+    if (!found) return false;
+    copiedBlock(*found, block);
+    return true;
+  }
+
+  std::pair<int, int> addressRange() const { return {rangeStart, rangeEnd}; }
+
+ private:
+  bool done() const { return result || failed; }
+
+  Dyninst::Address nextToMerge() const {
+    return merged < funcList.size() ? funcList[merged]->addr() : hint;
+  }
+
+  const vector<BlockInfo> &mergedBlocks(const BLOCK_ORDER order) const {
+    return order == MEMORY_ORDER ? assembly.addressOrderBlocks : assembly.loopOrderBlocks;
+  }
+
+  bool analyzed(const size_t funcIndex) const { return funcIndex < merged || results[funcIndex]; }
+
+  // The first block of an analyzed function that matches. Merged functions were moved
+  // into assembly, where only their loop order blocks are contiguous.
+  template <typename Match>
+  const BlockInfo *findFunctionBlock(const size_t funcIndex, const BLOCK_ORDER order, const Match &match) const {
+    auto blocks = std::span<const BlockInfo>();
+    if (funcIndex >= merged) {
+      blocks = order == MEMORY_ORDER ? results[funcIndex]->addressOrderBlocks : results[funcIndex]->loopOrderBlocks;
+    } else if (order == LOOP_ORDER) {
+      const auto begin = funcIndex > 0 ? assembly.functionBlockEnds[funcIndex - 1] : 0;
+      blocks = std::span(assembly.loopOrderBlocks).subspan(begin, assembly.functionBlockEnds[funcIndex] - begin);
+    } else {
+      blocks = assembly.addressOrderBlocks;
+    }
+    auto it = std::find_if(blocks.begin(), blocks.end(), match);
+    return it != blocks.end() ? &*it : nullptr;
+  }
+
+  size_t takeNearestPending() {
+    auto p = size_t(std::lower_bound(byEntry.begin(), byEntry.end(), std::make_pair(hint, size_t(0))) - byEntry.begin());
+    auto it = pending.lower_bound(p);
+    if (it == pending.end() || (it != pending.begin() &&
+        hint - byEntry[*std::prev(it)].first < byEntry[*it].first - hint))
+      it--;
+    auto funcIndex = byEntry[*it].second;
+    pending.erase(it);
+    return funcIndex;
+  }
+
+  void work() {
+    auto decoder = makeDecoder(funcList.front());
+    auto lock = std::unique_lock(m);
+    while (!pending.empty() && !failed) {
+      auto funcIndex = takeNearestPending();
+      lock.unlock();
+      auto analysis = std::shared_ptr<FunctionAnalysis>();
+      try {
+        analysis = std::make_shared<FunctionAnalysis>(analyzeFunction(ctx, funcList[funcIndex], funcIndex, decoder));
+      } catch (const std::exception &e) {
+        std::cerr << "Error: analysis of " << funcList[funcIndex]->name() << " in " << binaryPath << " failed: " << e.what() << std::endl;
+      }
+      lock.lock();
+      if (!analysis) {
+        failed = true;
+        job->update(PHASE_FAILED, false);
+        cv.notify_all();
+        return;
+      }
+      results[funcIndex] = std::move(analysis);
+      job->functionsDone++;
+      mergeReady(lock);
+      cv.notify_all();
+    }
+  }
+
+  // Merges the finished functions that directly follow the merged ones, moving them out
+  // of results. Called with m held. Once every function is merged the result is built
+  // and saved with m released, and requests wait for the result meanwhile.
+  void mergeReady(std::unique_lock<std::mutex> &lock) {
+    auto mergedBefore = merged;
+    for (; merged < funcList.size() && results[merged]; merged++) {
+      assembly.add(std::move(*results[merged]));
+      results[merged].reset();
+    }
+    if (merged == mergedBefore) return;
+
+    const auto &memoryOrder = assembly.addressOrderBlocks;
+    while (stable[MEMORY_ORDER] < memoryOrder.size() &&
+           memoryOrder[stable[MEMORY_ORDER]].startAddress <= lowestStartAfter[merged])
+      stable[MEMORY_ORDER]++;
+    stable[LOOP_ORDER] = assembly.loopOrderBlocks.size();
+
+    if (merged < funcList.size()) return;
+    stable[MEMORY_ORDER] = memoryOrder.size();
+    results.clear();
+    finishing = true;
+    auto finished = std::exchange(assembly, AssemblyResult());
+    lock.unlock();
+
+    auto built = makeBinaryCacheResult(finished, binaryHash);
+    lock.lock();
+    result = built;
+    cv.notify_all();
+    lock.unlock();
+
+    storeResult(binaryPath, built);
+    job->update(PHASE_SAVING, true);
+    saveAnalysisOutputs(binaryPath, built, finished, saveJson, binaryHash);
+    job->update(PHASE_DONE, true);
+    lock.lock();
+  }
+
+  const string binaryPath;
+  const bool saveJson;
+  const uint64_t binaryHash;
+  ParsedBinary parsed;
+  const std::shared_ptr<AnalysisJob> job;
+  vector<ParseAPI::Function *> funcList;
+  AnalysisContext ctx;
+  unordered_map<const ParseAPI::Function *, size_t> functionIndex;
+  unordered_map<string, size_t> blockFunction;           // block name -> function that names it
+  vector<int> lowestStartAfter;                         // lowest block start of functions i..n-1
+  vector<std::pair<Dyninst::Address, size_t>> byEntry;  // (entry, function index), sorted
+  int rangeStart = 0;
+  int rangeEnd = 0;
+
+  std::mutex m;
+  std::condition_variable cv;
+  std::set<size_t> pending;  // positions in byEntry not yet taken by a worker
+  Dyninst::Address hint;
+  vector<std::shared_ptr<FunctionAnalysis>> results;
+  size_t merged = 0;
+  AssemblyResult assembly;
+  size_t stable[2] = {0, 0};  // blocks of each order that can no longer move
+  bool finishing = false;     // every function is merged and the result is being built
+  std::shared_ptr<BinaryCacheResult> result;
+  bool failed = false;
+};
+
+// Running lazy analyses and the analysis jobs of every requested binary, guarded by
+// cacheMutex like binaryCacheResult
+auto lazyBinaries = map<string, std::shared_ptr<LazyBinary>>();
+auto analysisJobs = map<string, std::shared_ptr<AnalysisJob>>();
+
+// Binaries whose result was evicted. Their next job reloads the result from the on-disk
+// cache, or analyzes the binary again when there is none, without repeating the JSON
+// export written by the first analysis.
+auto evictedBinaries = std::set<string>();
+
+// Drops the least recently used results but the newest until they fit
+// AnalysisOptions::cacheMemoryLimit. Called with cacheMutex held exclusively.
+void evictResults() {
+  if (analysisOptions.cacheMemoryLimit == 0) return;
+  while (cachedBytes > analysisOptions.cacheMemoryLimit && recentResults.size() > 1) {
+    const auto binaryPath = recentResults.back();
+    auto it = binaryCacheResult.find(binaryPath);
+    cachedBytes -= it->second.bytes;
+    binaryCacheResult.erase(it);
+    recentResults.pop_back();
+    analysisJobs.erase(binaryPath);
+    evictedBinaries.insert(binaryPath);
+  }
+}
+
+void storeResult(const string &binaryPath, std::shared_ptr<BinaryCacheResult> res) {
+  const auto bytes = resultBytes(*res);
+  auto lock = std::unique_lock(cacheMutex);
+  lazyBinaries.erase(binaryPath);
+  if (auto it = binaryCacheResult.find(binaryPath); it != binaryCacheResult.end()) {
+    cachedBytes -= it->second.bytes;
+    recentResults.erase(it->second.position);
+    binaryCacheResult.erase(it);
+  }
+  recentResults.push_front(binaryPath);
+  binaryCacheResult.emplace(binaryPath, CachedResult{std::move(res), bytes, recentResults.begin()});
+  cachedBytes += bytes;
+  evictResults();
+}
+
+void addResultBytes(const BinaryCacheResult &res, const size_t bytes) {
+  if (analysisOptions.cacheMemoryLimit == 0) return;
+  auto lock = std::unique_lock(cacheMutex);
+  for (auto &[binaryPath, cached] : binaryCacheResult) {
+    if (cached.result.get() != &res) continue;
+    cached.bytes += bytes;
+    cachedBytes += bytes;
+    evictResults();
+    return;
+  }
+}
+
+// The running lazy analysis of binaryPath, or nullptr in eager mode and once the
+// analysis is finished, in which case the result is in binaryCacheResult
+std::shared_ptr<LazyBinary> getLazyBinary(const string &binaryPath) {
+  if (!analysisOptions.lazy) return nullptr;
+  auto lock = std::shared_lock(cacheMutex);
+  if (binaryCacheResult.find(binaryPath) != binaryCacheResult.end()) return nullptr;
+  auto it = lazyBinaries.find(binaryPath);
+  return it == lazyBinaries.end() ? nullptr : it->second;
+}
+
+// Analyzes binaryPath for job. Only the Dyninst parse waits for the jobs of other
+// binaries, so a cached binary loads while another one is being analyzed.
+void runAnalysisJob(const string binaryPath, const bool saveJson, const std::shared_ptr<AnalysisJob> job) {
+  job->update(PHASE_LOADING, false);
+  auto binaryHash = uint64_t(0);
+  if (loadCachedBinary(binaryPath, saveJson, binaryHash)) return job->update(PHASE_DONE, true);
+
+  job->update(PHASE_PARSING, false);
+  auto parsed = ParsedBinary();
+  auto funcList = vector<ParseAPI::Function *>();
+  auto ctx = AnalysisContext();
+  {
+    auto parseLock = std::lock_guard(parseMutex);
+    if (!parseBinary(binaryPath, parsed)) return job->update(PHASE_FAILED, false);
+    const auto &funcs = parsed.co->funcs();
+    funcList.assign(funcs.begin(), funcs.end());
+    ctx = prepareAnalysis(parsed.symtab.get(), funcList, analysisOptions.lazy);
+  }
+  job->setFunctionsTotal(funcList.size());
+
+  if (analysisOptions.lazy) {
+    auto lazy = std::make_shared<LazyBinary>(binaryPath, saveJson, binaryHash, std::move(parsed), std::move(funcList), std::move(ctx), job);
+    {
+      auto lock = std::unique_lock(cacheMutex);
+      lazyBinaries.emplace(binaryPath, lazy);
+    }
+    job->update(PHASE_ANALYZING, true);
+    lazy->start(analysisOptions.analysisThreads);
+    return;
+  }
+
+  job->update(PHASE_ANALYZING, false);
+  auto assembly = getAssembly(funcList, ctx, analysisOptions.analysisThreads, &job->functionsDone);
+  auto res = makeBinaryCacheResult(assembly, binaryHash);
+  storeResult(binaryPath, res);
+  job->update(PHASE_SAVING, true);
+  saveAnalysisOutputs(binaryPath, res, assembly, saveJson, binaryHash);
+  job->update(PHASE_DONE, true);
+}
+
+// The job of binaryPath, started on first use. Failed jobs are kept, so a binary
+// that can not be analyzed is not retried on every request.
+std::shared_ptr<AnalysisJob> startAnalysisJob(const string &binaryPath, const bool saveJson) {
+  {
+    auto lock = std::shared_lock(cacheMutex);
+    if (auto it = analysisJobs.find(binaryPath); it != analysisJobs.end()) return it->second;
+  }
+  auto lock = std::unique_lock(cacheMutex);
+  auto [it, inserted] = analysisJobs.try_emplace(binaryPath);
+  if (inserted) {
+    const auto reload = evictedBinaries.erase(binaryPath) > 0;
+    it->second = std::make_shared<AnalysisJob>();
+    std::thread(runAnalysisJob, binaryPath, saveJson && !reload, it->second).detach();
+  }
+  return it->second;
+}
+
+AnalysisStatus getAnalysisStatus(const string &binaryPath, const bool saveJson) {
+  return startAnalysisJob(binaryPath, saveJson)->status();
+}
+
+// Answers a query with lazyQuery while the lazy analysis of binaryPath runs, and with
+// resultQuery from its result once it is finished. A result evicted before it is found
+// is waited for again. False if the analysis failed.
+template <typename LazyQuery, typename ResultQuery>
+bool queryBinary(const string &binaryPath, const bool saveJson, LazyQuery lazyQuery, ResultQuery resultQuery) {
+  while (true) {
+    if (auto res = findResult(binaryPath)) return resultQuery(res);
+    if (!startAnalysisJob(binaryPath, saveJson)->wait(false)) return false;
+    if (auto lazy = getLazyBinary(binaryPath)) return lazyQuery(*lazy);
+  }
+}
+
+std::shared_ptr<BinaryCacheResult> decodeBinaryCache(const string binaryPath, const bool saveJson) {
+  while (true) {
+    if (!startAnalysisJob(binaryPath, saveJson)->wait(true)) return nullptr;
+    if (auto res = findResult(binaryPath)) return res;
+  }
+}
+
+bool getDisassemblyPage(const string &binaryPath, const bool saveJson, const BLOCK_ORDER order, const int pageNo, DisassemblyPage &page) {
+  if (pageNo < 0) return false;
+  return queryBinary(
+      binaryPath, saveJson, [&](LazyBinary &lazy) { return lazy.page(order, pageNo, page); },
+      [&](const std::shared_ptr<BinaryCacheResult> &res) { return pageAt(res, order, size_t(pageNo) * BLOCKS_PER_PAGE, page); });
+}
+
+bool getDisassemblyPageByAddress(const string &binaryPath, const bool saveJson, const BLOCK_ORDER order, const unsigned long address, DisassemblyPage &page) {
+  return queryBinary(
+      binaryPath, saveJson, [&](LazyBinary &lazy) { return lazy.pageByAddress(order, address, page); },
+      [&](const std::shared_ptr<BinaryCacheResult> &res) { return resultPageByAddress(res, order, address, page); });
+}
+
+bool getDisassemblyBlockById(const string &binaryPath, const bool saveJson, const BLOCK_ORDER order, const string &id, DisassemblyBlock &block) {
+  return queryBinary(
+      binaryPath, saveJson, [&](LazyBinary &lazy) { return lazy.blockById(order, id, block); },
+      [&](const std::shared_ptr<BinaryCacheResult> &res) { return resultBlockById(res, order, id, block); });
+}
+
+bool getDisassemblyBlockByAddress(const string &binaryPath, const bool saveJson, const BLOCK_ORDER order, const unsigned long address, DisassemblyBlock &block) {
+  return queryBinary(
+      binaryPath, saveJson, [&](LazyBinary &lazy) { return lazy.blockByAddress(order, address, block); },
+      [&](const std::shared_ptr<BinaryCacheResult> &res) { return resultBlockByAddress(res, order, address, block); });
+}
+
+bool getAddressRange(const string &binaryPath, const bool saveJson, int &start, int &end) {
+  auto lazyRange = [&](LazyBinary &lazy) {
+    std::tie(start, end) = lazy.addressRange();
+    return true;
+  };
+  auto resultRange = [&](const std::shared_ptr<BinaryCacheResult> &res) {
+    const auto &blocks = res->disassembly.memory_order_blocks;
+    if (blocks.empty()) return false;
+    start = std::ranges::min_element(blocks, [](const BlockInfo &a, const BlockInfo &b) { return a.startAddress < b.startAddress; })->startAddress;
+    end = std::ranges::max_element(blocks, [](const BlockInfo &a, const BlockInfo &b) { return a.startAddress < b.startAddress; })->endAddress;
+    return true;
+  };
+  return queryBinary(binaryPath, saveJson, lazyRange, resultRange);
+}
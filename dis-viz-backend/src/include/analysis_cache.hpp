@@ -0,0 +1,12 @@
+#pragma once
+
+#include <dyninst_wrapper.hpp>
+#include <cstdint>
+#include <string>
+
+// Bump whenever the layout of BinaryCacheResult or of the cache file changes
+#define ANALYSIS_CACHE_VERSION 6
+
+uint64_t hashBinaryContents(const std::string &binaryPath);
+bool loadAnalysisCache(const std::string &cacheDir, const uint64_t binaryHash, BinaryCacheResult &result);
+bool saveAnalysisCache(const std::string &cacheDir, const uint64_t binaryHash, const BinaryCacheResult &result);
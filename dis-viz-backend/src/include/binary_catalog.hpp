@@ -0,0 +1,45 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct CatalogEntry {
+  std::string name;
+  std::string path;
+};
+
+// The parsable binaries among the configured files and the files of the configured
+// directories. Which files are parsable is remembered by (path, size, mtime), so a
+// rescan only stats the files and checks the new or changed ones by their ELF and
+// section headers. Safe to share between server threads.
+class BinaryCatalog {
+ public:
+  explicit BinaryCatalog(std::vector<std::string> paths) : paths(std::move(paths)) {}
+
+  // The binaries as of the last scan, rescanning when it is older than RESCAN_INTERVAL
+  std::vector<CatalogEntry> list();
+
+  static constexpr auto RESCAN_INTERVAL = std::chrono::seconds(2);
+
+ private:
+  struct Verdict {
+    uintmax_t size;
+    std::filesystem::file_time_type modified;
+    bool parsable;
+  };
+
+  void scan();
+  void addFile(const std::filesystem::path &path, std::unordered_map<std::string, Verdict> &seen);
+
+  std::mutex m;
+  const std::vector<std::string> paths;
+  std::unordered_map<std::string, Verdict> verdicts;
+  std::vector<CatalogEntry> entries;
+  std::chrono::steady_clock::time_point lastScan;
+  bool scanned = false;
+};
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+
+// Bodies smaller than this are sent uncompressed
+#define MIN_COMPRESSED_SIZE 1024
+
+enum CONTENT_CODING { CODING_IDENTITY, CODING_GZIP, CODING_DEFLATE };
+
+// A response body as sent, with the coding applied to it
+struct EncodedBody {
+  std::string data;
+  CONTENT_CODING coding;
+};
+
+// The coding to answer with given an Accept-Encoding header, gzip first
+CONTENT_CODING chooseContentCoding(const std::string &acceptEncoding);
+const char *contentCodingName(const CONTENT_CODING coding);
+// Compresses body with coding, unless it is smaller than MIN_COMPRESSED_SIZE or zlib fails
+EncodedBody encodeBody(std::string body, const CONTENT_CODING coding);
@@ -1,5 +1,9 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <span>
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -17,10 +21,25 @@ typedef enum {
   INST_FP
 } INSTRUCTION_FLAGS;
 
+// The number of instructions with each INSTRUCTION_FLAGS
+using InstructionFlagCounts = std::array<int, INST_FP + 1>;
+
+// The INSTRUCTION_FLAGS of one instruction, one bit per flag
+struct InstructionFlags {
+  uint8_t bits = 0;
+
+  void insert(const INSTRUCTION_FLAGS flag) { bits |= 1u << flag; }
+  bool contains(const INSTRUCTION_FLAGS flag) const { return bits & (1u << flag); }
+  InstructionFlags &operator|=(const InstructionFlags &other) {
+    bits |= other.bits;
+    return *this;
+  }
+};
+
 struct VarLocation {
-  std::string start;
-  std::string end;
-  std::string location;
+  unsigned long start;
+  unsigned long end;      // exclusive
+  std::string location;   // operand text as it appears in the disassembly
 };
 struct VariableInfo {
   std::string name;
@@ -57,7 +76,7 @@ struct InstructionInfo {
   std::unordered_map<std::string, std::vector<int> >
       correspondence;  // { source_file: [line_number] }
   std::vector<VariableInfo> variables;
-  std::unordered_set<INSTRUCTION_FLAGS> flags;
+  InstructionFlags flags;
 };
 struct BasicBlock {
   std::string id;
@@ -101,6 +120,9 @@ struct BlockInfo {
   int startAddress;
   int endAddress;
   int nInstructions;
+  InstructionFlags flags; // of all its instructions
+  InstructionFlagCounts flagCounts{};
+  bool builtIn = false;   // some instruction comes from a system header
 };
 
 struct MinimapInfo {
@@ -111,6 +133,35 @@ struct MinimapInfo {
   std::vector<std::vector<std::string>> block_types;
 };
 
+// One level of the minimap pyramid of an order. Bucket i aggregates the blocks
+// [i * bucket_blocks, (i + 1) * bucket_blocks). Level 0 has a bucket per block and
+// every next level MINIMAP_LEVEL_FACTOR times fewer, down to a single bucket.
+struct MinimapLevel {
+  int bucket_blocks;
+  std::vector<int> start_address;   // of the first block
+  std::vector<int> instructions;    // of the normal blocks, like MinimapInfo::block_heights
+  std::vector<int> built_in_blocks; // normal blocks from system headers
+  std::vector<int> loop_depth;      // deepest loop nesting
+  std::vector<int> type_bits;       // InstructionFlags of any instruction of the normal blocks
+  std::vector<int> dominant_type;   // INSTRUCTION_FLAGS of the most instructions, -1 if none has a flag
+};
+
+#define MINIMAP_LEVEL_FACTOR 4
+
+// The buckets [startBucket, endBucket) of a minimap level
+struct MinimapTile {
+  const MinimapLevel *level = nullptr;
+  int levelNo = 0;
+  size_t startBucket = 0;
+  size_t endBucket = 0;
+};
+
+// Lookup tables over the blocks of one order
+struct BlockIndex {
+  std::vector<std::pair<int, unsigned int>> by_address; // (start address, position), sorted
+  std::unordered_map<std::string, unsigned int> by_id;  // block name -> first position
+};
+
 enum SourceCodeTags {
   INLINE_TAG,
   VECTORIZED_TAG
@@ -127,9 +178,96 @@ struct BinaryCacheResult {
   std::vector<std::string> source_files;
   std::unordered_map<std::string, std::map<int, std::vector<unsigned long>>> correspondences; // { source_file: { line_number: [addresses] } }
   std::unordered_map<std::string, std::map<int, std::unordered_set<SourceCodeTags>>> sourceCodeInfo;
+  struct {
+    BlockIndex memory_order;
+    BlockIndex loop_order;
+  } block_index; // built from disassembly, not cached
+  struct {
+    std::vector<MinimapLevel> memory_order;
+    std::vector<MinimapLevel> loop_order;
+  } minimap_levels; // built from disassembly and minimap, not cached
+  uint64_t binary_hash = 0; // content hash of the binary, 0 if it could not be read
+  mutable struct {
+    std::vector<std::string> memory_order;
+    std::vector<std::string> loop_order;
+  } block_json; // serialized blocks, parallel to disassembly and filled on first use
 };
 
+struct AnalysisOptions {
+  unsigned int analysisThreads = 1; // 0 uses every hardware thread
+  std::string cacheDir;             // on-disk analysis cache, disabled when empty
+  bool lazy = false;                // analyze functions in the background, as they are requested
+  bool jsonLines = false;           // --save-json writes one line per function instead of one document
+  size_t cacheMemoryLimit = 0;      // bytes of analysis results kept in memory, unlimited when 0.
+                                    // Evicted results are reloaded from cacheDir or analyzed again
+};
 
+#define BLOCKS_PER_PAGE 100
 
+enum BLOCK_ORDER { MEMORY_ORDER, LOOP_ORDER };
+
+// A page of blocks. Pages of a finished analysis point into the cached result,
+// pages of an analysis still in progress own a copy of their blocks.
+struct DisassemblyPage {
+  std::span<const BlockInfo> blocks;
+  std::span<std::string> json; // serialized blocks, parallel to blocks. Empty while in progress
+  std::vector<BlockInfo> storage;
+  int pageNo;
+  bool isLast;
+  uint64_t binaryHash = 0; // BinaryCacheResult::binary_hash of a finished analysis
+  std::shared_ptr<const BinaryCacheResult> result; // keeps the result of a finished analysis alive
+
+  bool isFinal() const { return storage.empty(); }
+};
+
+// A block, pointing into the cached result like DisassemblyPage
+struct DisassemblyBlock {
+  const BlockInfo *block = nullptr;
+  std::string *json = nullptr; // serialized block, nullptr while the analysis is in progress
+  BlockInfo storage;
+  uint64_t binaryHash = 0;     // BinaryCacheResult::binary_hash of a finished analysis
+  std::shared_ptr<const BinaryCacheResult> result;
+};
+
+enum ANALYSIS_PHASE { PHASE_QUEUED, PHASE_LOADING, PHASE_PARSING, PHASE_ANALYZING, PHASE_SAVING, PHASE_DONE, PHASE_FAILED };
+
+// Progress of the background analysis of a binary
+struct AnalysisStatus {
+  ANALYSIS_PHASE phase = PHASE_QUEUED;
+  size_t functionsDone = 0;
+  size_t functionsTotal = 0; // known once the binary is parsed
+  bool queryable = false;    // pages and blocks can be requested. With AnalysisOptions::lazy before the analysis is done
+
+  // Whether the whole result is available, e.g. the minimap
+  bool isReady() const { return phase == PHASE_SAVING || phase == PHASE_DONE; }
+};
+
+void setAnalysisOptions(const AnalysisOptions &options);
 bool isParsable(const std::string &binaryPath);
-BinaryCacheResult* decodeBinaryCache(std::string binaryPath, const bool saveJson);
\ No newline at end of file
+
+// Status of the analysis of binaryPath, which is started in the background on first use.
+// Concurrent callers share a single analysis per path.
+AnalysisStatus getAnalysisStatus(const std::string &binaryPath, const bool saveJson);
+
+// Waits for the whole analysis of binaryPath, including its cache and JSON outputs
+std::shared_ptr<BinaryCacheResult> decodeBinaryCache(std::string binaryPath, const bool saveJson);
+// Counts bytes of block_json filled after res was stored toward AnalysisOptions::cacheMemoryLimit,
+// evicting results that no longer fit. Results already evicted are not counted.
+void addResultBytes(const BinaryCacheResult &res, const size_t bytes);
+
+// The tile of the finest minimap level of order that covers the blocks [startBlock, endBlock)
+// in at most maxBuckets buckets. False if the order has no blocks.
+bool getMinimapTile(const BinaryCacheResult &res, const BLOCK_ORDER order, size_t startBlock, size_t endBlock,
+                    const size_t maxBuckets, MinimapTile &tile);
+// The positions [startBlock, endBlock) of order spanning the blocks that overlap
+// [startAddress, endAddress]. A window between blocks spans the blocks around it.
+void getBlockRange(const BinaryCacheResult &res, const BLOCK_ORDER order, const unsigned long startAddress,
+                   const unsigned long endAddress, size_t &startBlock, size_t &endBlock);
+
+// Queries that wait until the analysis is queryable and, with AnalysisOptions::lazy,
+// only for the functions they need
+bool getDisassemblyPage(const std::string &binaryPath, const bool saveJson, const BLOCK_ORDER order, const int pageNo, DisassemblyPage &page);
+bool getDisassemblyPageByAddress(const std::string &binaryPath, const bool saveJson, const BLOCK_ORDER order, const unsigned long address, DisassemblyPage &page);
+bool getDisassemblyBlockById(const std::string &binaryPath, const bool saveJson, const BLOCK_ORDER order, const std::string &id, DisassemblyBlock &block);
+bool getDisassemblyBlockByAddress(const std::string &binaryPath, const bool saveJson, const BLOCK_ORDER order, const unsigned long address, DisassemblyBlock &block);
+bool getAddressRange(const std::string &binaryPath, const bool saveJson, int &start, int &end);
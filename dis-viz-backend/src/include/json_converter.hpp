@@ -1,7 +1,25 @@
 #include <dyninst_wrapper.hpp>
 #include <crow/json.h>
+#include <iosfwd>
 
 crow::json::wvalue convertMinimapInfo(const MinimapInfo &minimap);
+crow::json::wvalue convertMinimapTile(const MinimapTile &tile);
 crow::json::wvalue convertBlockInfo(const BlockInfo &block);
 crow::json::wvalue convertBinaryCache(const BinaryCacheResult *res);
-crow::json::wvalue convertFunctionInfos(const std::vector<FunctionInfo> &funcInfos);
\ No newline at end of file
+crow::json::wvalue convertDisassemblyPage(const DisassemblyPage &page);
+// Response bodies built from the serialized blocks kept in the cached result
+std::string serializeDisassemblyPage(const DisassemblyPage &page);
+std::string serializeDisassemblyBlock(const DisassemblyBlock &block);
+// block serialized into fragment on first use, safe to call from several threads.
+// The bytes of a fragment serialized by this call are added to filledBytes.
+const std::string &blockFragment(const BlockInfo &block, std::string &fragment, size_t *filledBytes = nullptr);
+crow::json::wvalue convertFunctionInfos(const std::vector<FunctionInfo> &funcInfos);
+
+// The --save-json export, written one block and one function at a time so the
+// whole document is never held in memory
+void writeBinaryJson(std::ostream &o, const BinaryCacheResult *res, const std::vector<FunctionInfo> &funcInfos);
+// JSON Lines variant: a line with the source files, then one line per function holding
+// its info and its blocks in loop order. functionBlockEnds[i] is the loop order
+// position after the last block of function i.
+void writeBinaryJsonLines(std::ostream &o, const BinaryCacheResult *res, const std::vector<FunctionInfo> &funcInfos,
+                          const std::vector<size_t> &functionBlockEnds);
\ No newline at end of file
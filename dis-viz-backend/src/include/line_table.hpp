@@ -0,0 +1,77 @@
+#pragma once
+
+#include <algorithm>
+#include <set>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <Symtab.h>
+
+// The DWARF line table of a binary, read once and kept as sorted address
+// intervals. Lookups are a binary search, and every line of a source file
+// points to one shared copy of its file name.
+class LineTable {
+ public:
+  struct Line {
+    const std::string *file;
+    int line;
+  };
+
+  LineTable() = default;
+  explicit LineTable(Dyninst::SymtabAPI::Symtab *symtab) {
+    struct Range {
+      Dyninst::Offset start;
+      Dyninst::Offset end;
+      Line line;
+    };
+    auto ranges = std::vector<Range>();
+    auto modules = std::vector<Dyninst::SymtabAPI::Module *>();
+    symtab->getAllModules(modules);
+    for (auto module : modules) {
+      auto statements = std::vector<Dyninst::SymtabAPI::Statement::Ptr>();
+      module->getStatements(statements);
+      for (const auto &statement : statements) {
+        if (statement->startAddr() >= statement->endAddr()) continue;
+        auto file = &*fileNames.insert(statement->getFile()).first;
+        ranges.push_back({statement->startAddr(), statement->endAddr(), {file, (int)statement->getLine()}});
+      }
+    }
+
+    // Split the address space at every range bound. Each segment lists the lines covering it.
+    for (const auto &range : ranges) {
+      bounds.push_back(range.start);
+      bounds.push_back(range.end);
+    }
+    std::sort(bounds.begin(), bounds.end());
+    bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+
+    auto segmentLines = std::vector<std::vector<Line>>(bounds.size());
+    for (const auto &range : ranges) {
+      auto first = std::lower_bound(bounds.begin(), bounds.end(), range.start) - bounds.begin();
+      auto last = std::lower_bound(bounds.begin(), bounds.end(), range.end) - bounds.begin();
+      for (auto i = first; i < last; i++) segmentLines[i].push_back(range.line);
+    }
+    offsets.reserve(bounds.size() + 1);
+    for (const auto &segment : segmentLines) {
+      offsets.push_back(lines.size());
+      lines.insert(lines.end(), segment.begin(), segment.end());
+    }
+    offsets.push_back(lines.size());
+  }
+
+  // The lines of the instruction at address, like Symtab::getSourceLines
+  std::span<const Line> at(const Dyninst::Offset address) const {
+    auto segment = std::upper_bound(bounds.begin(), bounds.end(), address) - bounds.begin();
+    if (segment == 0) return {};
+    return std::span<const Line>(lines.data() + offsets[segment - 1], lines.data() + offsets[segment]);
+  }
+
+  const std::set<std::string> &files() const { return fileNames; }
+
+ private:
+  std::set<std::string> fileNames;
+  std::vector<Dyninst::Offset> bounds;  // sorted and unique
+  std::vector<size_t> offsets;          // lines of segment i are lines[offsets[i], offsets[i + 1])
+  std::vector<Line> lines;
+};
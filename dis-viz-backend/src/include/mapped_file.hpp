@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Read-only memory mapping of a whole file. An empty or unreadable file
+// gives an invalid mapping.
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string &path) {
+    auto fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+      auto ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (ptr != MAP_FAILED) {
+        fileData = static_cast<const uint8_t *>(ptr);
+        fileSize = st.st_size;
+      }
+    }
+    close(fd);
+  }
+  ~MappedFile() {
+    if (fileData) munmap(const_cast<uint8_t *>(fileData), fileSize);
+  }
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  bool valid() const { return fileData != nullptr; }
+  const uint8_t *data() const { return fileData; }
+  size_t size() const { return fileSize; }
+
+ private:
+  const uint8_t *fileData = nullptr;
+  size_t fileSize = 0;
+};
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <dyninst_wrapper.hpp>
+#include <string>
+
+// MessagePack encodings with the same layout as the json_converter responses.
+// Minimap arrays are packed as typed arrays.
+std::string packMinimapInfo(const MinimapInfo &minimap);
+std::string packMinimapTile(const MinimapTile &tile);
+std::string packDisassemblyPage(const DisassemblyPage &page);
+std::string packBlockInfo(const BlockInfo &block);
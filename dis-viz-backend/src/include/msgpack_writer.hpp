@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#define MSGPACK_MIME "application/msgpack"
+
+// Appends MessagePack values to a string. Numeric arrays can also be written as
+// ext values of packed little-endian data, which clients read as typed arrays.
+class MsgpackWriter {
+ public:
+  enum ExtType : uint8_t {
+    EXT_INT32_ARRAY = 1,
+    EXT_BOOL_ARRAY = 2,
+  };
+
+  void nil() { byte(0xc0); }
+
+  void boolean(const bool value) { byte(value ? 0xc3 : 0xc2); }
+
+  void integer(const int64_t value) {
+    if (value >= 0) return uinteger(value);
+    if (value >= -32) return byte(uint8_t(value));
+    if (value >= INT8_MIN) return header(0xd0, uint8_t(value), 1);
+    if (value >= INT16_MIN) return header(0xd1, uint16_t(value), 2);
+    if (value >= INT32_MIN) return header(0xd2, uint32_t(value), 4);
+    header(0xd3, uint64_t(value), 8);
+  }
+
+  void uinteger(const uint64_t value) {
+    if (value < 0x80) return byte(value);
+    if (value <= UINT8_MAX) return header(0xcc, value, 1);
+    if (value <= UINT16_MAX) return header(0xcd, value, 2);
+    if (value <= UINT32_MAX) return header(0xce, value, 4);
+    header(0xcf, value, 8);
+  }
+
+  void str(const std::string_view value) {
+    if (value.size() < 32) byte(0xa0 | value.size());
+    else if (value.size() <= UINT8_MAX) header(0xd9, value.size(), 1);
+    else if (value.size() <= UINT16_MAX) header(0xda, value.size(), 2);
+    else header(0xdb, value.size(), 4);
+    out.append(value);
+  }
+
+  void array(const size_t size) {
+    if (size < 16) byte(0x90 | size);
+    else if (size <= UINT16_MAX) header(0xdc, size, 2);
+    else header(0xdd, size, 4);
+  }
+
+  void map(const size_t size) {
+    if (size < 16) byte(0x80 | size);
+    else if (size <= UINT16_MAX) header(0xde, size, 2);
+    else header(0xdf, size, 4);
+  }
+
+  void int32Array(const std::span<const int> values) {
+    ext(EXT_INT32_ARRAY, values.size() * 4);
+    for (const auto value : values) {
+      auto bits = uint32_t(value);
+      for (int i = 0; i < 4; i++, bits >>= 8) byte(bits & 0xff);
+    }
+  }
+
+  void boolArray(const std::vector<bool> &values) {
+    ext(EXT_BOOL_ARRAY, values.size());
+    for (const auto value : values) byte(value ? 1 : 0);
+  }
+
+  std::string take() { return std::move(out); }
+
+ private:
+  void byte(const uint8_t b) { out.push_back(char(b)); }
+
+  // A type byte followed by a big-endian value of size bytes
+  void header(const uint8_t type, const uint64_t value, const int size) {
+    byte(type);
+    for (int shift = (size - 1) * 8; shift >= 0; shift -= 8) byte((value >> shift) & 0xff);
+  }
+
+  void ext(const ExtType type, const size_t size) {
+    if (size <= UINT8_MAX) header(0xc7, size, 1);
+    else if (size <= UINT16_MAX) header(0xc8, size, 2);
+    else header(0xc9, size, 4);
+    byte(type);
+  }
+
+  std::string out;
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+
+#include <compression.hpp>
+
+// Response bodies of disassembly pages as sent, keyed by
+// (binary, content hash of the binary, order, page, encoding, requested content coding).
+// The hash keeps the pages of a binary that changed on disk apart from the new ones.
+// Least recently used pages are dropped once the bodies exceed maxBytes. Safe to share
+// between server threads.
+class PageCache {
+ public:
+  using Key = std::tuple<std::string, uint64_t, int, int, int, int>;
+  using Body = std::shared_ptr<const EncodedBody>;
+
+  explicit PageCache(const size_t maxBytes) : maxBytes(maxBytes) {}
+
+  // The cached body of key, or nullptr
+  Body get(const Key &key) {
+    auto lock = std::lock_guard(m);
+    auto it = entries.find(key);
+    if (it == entries.end()) return nullptr;
+    recent.splice(recent.begin(), recent, it->second.position);
+    return it->second.body;
+  }
+
+  void put(const Key &key, Body body) {
+    if (body->data.size() > maxBytes) return;
+    auto lock = std::lock_guard(m);
+    auto it = entries.find(key);
+    if (it != entries.end()) {
+      bytes -= it->second.body->data.size();
+      recent.erase(it->second.position);
+      entries.erase(it);
+    }
+    bytes += body->data.size();
+    recent.push_front(key);
+    entries.emplace(key, Entry{std::move(body), recent.begin()});
+
+    while (bytes > maxBytes) {
+      auto oldest = entries.find(recent.back());
+      bytes -= oldest->second.body->data.size();
+      entries.erase(oldest);
+      recent.pop_back();
+    }
+  }
+
+ private:
+  struct Entry {
+    Body body;
+    std::list<Key>::iterator position;
+  };
+
+  std::mutex m;
+  size_t maxBytes;
+  size_t bytes = 0;
+  std::list<Key> recent;  // most recently used first
+  std::map<Key, Entry> entries;
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <dyninst_wrapper.hpp>
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+// A source file read into memory with the offset of every line. Lines are split
+// like std::getline, so a trailing newline does not start another line. The text is
+// a copy, since source files are edited in place while they are being served.
+class SourceText {
+ public:
+  explicit SourceText(const std::string &path);
+
+  bool exists() const { return fileExists; }
+  uintmax_t size() const { return fileSize; }
+  std::filesystem::file_time_type modified() const { return fileModified; }
+  size_t lineCount() const { return lineStarts.size() - 1; }
+  // Line i without its newline
+  std::string_view line(const size_t i) const {
+    return {contents.data() + lineStarts[i], lineStarts[i + 1] - lineStarts[i] - 1};
+  }
+
+ private:
+  std::string contents;
+  bool fileExists = false;
+  uintmax_t fileSize = 0;
+  std::filesystem::file_time_type fileModified;
+  std::vector<size_t> lineStarts; // start of every line, then one past the end of the last newline
+};
+
+// The addresses and tags of the lines of one source file that have any, sorted by line
+struct SourceLineIndex {
+  std::vector<int> lines;
+  std::vector<uint32_t> addressStarts; // addresses of lines[i] are [addressStarts[i], addressStarts[i + 1])
+  std::vector<unsigned long> addresses;
+  std::vector<uint8_t> tags;           // one bit per SourceCodeTags
+};
+
+SourceLineIndex makeSourceLineIndex(const BinaryCacheResult &res, const std::string &sourceFile);
+
+// The /api/getsourcefile body for the lines [startLine, endLine) of text
+std::string serializeSourceLines(const SourceText &text, const SourceLineIndex &index, const size_t startLine, const size_t endLine);
+
+// Source files and their line indexes, shared by the server threads. A file is
+// read again once its size or modification time changes. Line indexes are keyed by
+// the content hash of the binary. Once MAX_ENTRIES are cached the least recently used is dropped.
+class SourceCache {
+ public:
+  std::shared_ptr<const SourceText> text(const std::string &path);
+  std::shared_ptr<const SourceLineIndex> lineIndex(const BinaryCacheResult &res, const std::string &sourceFile);
+
+  static constexpr size_t MAX_ENTRIES = 256;
+
+ private:
+  template <typename T>
+  struct Entry {
+    std::shared_ptr<const T> value;
+    uint64_t lastUse;
+  };
+
+  template <typename Key, typename T>
+  void insert(std::map<Key, Entry<T>> &entries, const Key &key, std::shared_ptr<const T> value);
+
+  std::mutex m;
+  uint64_t uses = 0;
+  std::map<std::string, Entry<SourceText>> texts;
+  std::map<std::tuple<uint64_t, std::string>, Entry<SourceLineIndex>> indexes;
+};
@@ -1,5 +1,9 @@
 #include "dyninst_wrapper.hpp"
 #include <json_converter.hpp>
+#include <array>
+#include <mutex>
+#include <numeric>
+#include <ostream>
 
 using json = crow::json::wvalue;
 
@@ -41,6 +45,25 @@ json convertMinimapInfo(const MinimapInfo &minimap) {
   return result;
 }
 
+json convertMinimapTile(const MinimapTile &tile) {
+  const auto &level = *tile.level;
+  const auto window = [&tile](const std::vector<int> &values) {
+    return std::vector<int>(values.begin() + tile.startBucket, values.begin() + tile.endBucket);
+  };
+  auto result = json();
+  result["level"] = tile.levelNo;
+  result["bucket_blocks"] = level.bucket_blocks;
+  result["start_bucket"] = tile.startBucket;
+  result["n_buckets"] = level.start_address.size();
+  result["start_address"] = window(level.start_address);
+  result["instructions"] = window(level.instructions);
+  result["built_in_blocks"] = window(level.built_in_blocks);
+  result["loop_depth"] = window(level.loop_depth);
+  result["type_bits"] = window(level.type_bits);
+  result["dominant_type"] = window(level.dominant_type);
+  return result;
+}
+
 json convertInstructionInfo(const InstructionInfo &instruction) {
   auto result = json();
   result["address"] = instruction.address;
@@ -59,28 +82,11 @@ json convertInstructionInfo(const InstructionInfo &instruction) {
 
     result["variables"] = std::move(variables);
   }
+  static const char *flagNames[] = {"INST_VECTORIZED", "INST_MEMORY_READ", "INST_MEMORY_WRITE",
+                                    "INST_CALL", "INST_SYSCALL", "INST_FP"};
   auto flags = std::vector<std::string>();
-  for (const auto &flag : instruction.flags) {
-    switch (flag) {
-    case INST_VECTORIZED:
-      flags.push_back("INST_VECTORIZED");
-      break;
-    case INST_MEMORY_READ:
-      flags.push_back("INST_MEMORY_READ");
-      break;
-    case INST_MEMORY_WRITE:
-      flags.push_back("INST_MEMORY_WRITE");
-      break;
-    case INST_CALL:
-      flags.push_back("INST_CALL");
-      break;
-    case INST_SYSCALL:
-      flags.push_back("INST_SYSCALL");
-      break;
-    case INST_FP:
-      flags.push_back("INST_FP");
-      break;
-    }
+  for (int flag = INST_VECTORIZED; flag <= INST_FP; flag++) {
+    if (instruction.flags.contains(INSTRUCTION_FLAGS(flag))) flags.push_back(flagNames[flag]);
   }
   result["flags"] = flags;
 
@@ -149,6 +155,71 @@ json convertBinaryCache(const BinaryCacheResult *res) {
   return result;
 }
 
+json convertDisassemblyPage(const DisassemblyPage &page) {
+  auto pageJson = json::list();
+  for (const auto &i : page.blocks) {
+    pageJson.push_back(convertBlockInfo(i));
+  }
+  auto n_instructions = std::accumulate(
+      page.blocks.begin(), page.blocks.end(), 0,
+      [](int sum, const BlockInfo &i) { return sum + i.nInstructions; });
+
+  return json({{"end_address", page.blocks.back().endAddress},
+               {"is_last", page.isLast},
+               {"blocks", pageJson},
+               {"n_instructions", n_instructions},
+               {"page_no", page.pageNo},
+               {"start_address", page.blocks.front().startAddress}});
+}
+
+// Serializes block once into fragment, which then stands in for it in every response.
+// Fragments are filled under one of a few striped locks and never change afterwards.
+const std::string &blockFragment(const BlockInfo &block, std::string &fragment, size_t *filledBytes) {
+  static auto fragmentMutexes = std::array<std::mutex, 64>();
+  auto lock = std::lock_guard(fragmentMutexes[(reinterpret_cast<uintptr_t>(&fragment) / sizeof(std::string)) % fragmentMutexes.size()]);
+  if (fragment.empty()) {
+    fragment = convertBlockInfo(block).dump();
+    if (filledBytes) *filledBytes += fragment.capacity() + 1;
+  }
+  return fragment;
+}
+
+std::string serializeDisassemblyPage(const DisassemblyPage &page) {
+  if (page.json.empty()) return convertDisassemblyPage(page).dump();
+
+  auto size = size_t(0);
+  auto filledBytes = size_t(0);
+  auto n_instructions = 0;
+  for (size_t i = 0; i < page.blocks.size(); i++) {
+    size += blockFragment(page.blocks[i], page.json[i], &filledBytes).size() + 1;
+    n_instructions += page.blocks[i].nInstructions;
+  }
+  if (filledBytes > 0 && page.result) addResultBytes(*page.result, filledBytes);
+
+  auto body = std::string();
+  body.reserve(size + 128);
+  body += "{\"blocks\":[";
+  for (size_t i = 0; i < page.json.size(); i++) {
+    if (i > 0) body += ',';
+    body += page.json[i];
+  }
+  body += "],\"end_address\":" + std::to_string(page.blocks.back().endAddress);
+  body += ",\"is_last\":";
+  body += page.isLast ? "true" : "false";
+  body += ",\"n_instructions\":" + std::to_string(n_instructions);
+  body += ",\"page_no\":" + std::to_string(page.pageNo);
+  body += ",\"start_address\":" + std::to_string(page.blocks.front().startAddress) + "}";
+  return body;
+}
+
+std::string serializeDisassemblyBlock(const DisassemblyBlock &block) {
+  if (!block.json) return convertBlockInfo(*block.block).dump();
+  auto filledBytes = size_t(0);
+  const auto &fragment = blockFragment(*block.block, *block.json, &filledBytes);
+  if (filledBytes > 0 && block.result) addResultBytes(*block.result, filledBytes);
+  return fragment;
+}
+
 json convertCall(const Call &call) {
   auto result = json();
   result["address"] = call.address;
@@ -196,63 +267,107 @@ json convertHidable(const Hidable &hidable) {
   return result;
 }
 
-json convertFunctionInfos(const std::vector<FunctionInfo> &funcInfos) {
-  auto result = json::list();
-  for (const auto &funcInfo : funcInfos) {
-    auto funcInfoJson = json();
-    funcInfoJson["name"] = funcInfo.name;
-    funcInfoJson["entry"] = funcInfo.entry;
-
-    // TODO: Add all fields
-    funcInfoJson["basic_blocks"] = funcInfo.basic_blocks;
-
-    if (funcInfo.localVars.size() > 0) {
-      auto vars = json::list();
-      for (auto &var : funcInfo.localVars) {
-        vars.push_back(convertVariableInfo(var));
-      }
-      funcInfoJson["localVars"] = std::move(vars);
+json convertFunctionInfo(const FunctionInfo &funcInfo) {
+  auto funcInfoJson = json();
+  funcInfoJson["name"] = funcInfo.name;
+  funcInfoJson["entry"] = funcInfo.entry;
+
+  // TODO: Add all fields
+  funcInfoJson["basic_blocks"] = funcInfo.basic_blocks;
+
+  if (funcInfo.localVars.size() > 0) {
+    auto vars = json::list();
+    for (auto &var : funcInfo.localVars) {
+      vars.push_back(convertVariableInfo(var));
     }
-    if (funcInfo.params.size() > 0) {
-      auto vars = json::list();
-      for (auto &var : funcInfo.params) {
-        vars.push_back(convertVariableInfo(var));
-      }
-      funcInfoJson["params"] = std::move(vars);
+    funcInfoJson["localVars"] = std::move(vars);
+  }
+  if (funcInfo.params.size() > 0) {
+    auto vars = json::list();
+    for (auto &var : funcInfo.params) {
+      vars.push_back(convertVariableInfo(var));
     }
+    funcInfoJson["params"] = std::move(vars);
+  }
 
-    if (funcInfo.calls.size() > 0) {
-      auto calls = json::list();
-      for (auto &call : funcInfo.calls) {
-        calls.push_back(convertCall(call));
-      }
-      funcInfoJson["calls"] = std::move(calls);
+  if (funcInfo.calls.size() > 0) {
+    auto calls = json::list();
+    for (auto &call : funcInfo.calls) {
+      calls.push_back(convertCall(call));
     }
+    funcInfoJson["calls"] = std::move(calls);
+  }
 
-    if (funcInfo.inlines.size() > 0) {
-      auto inlines = json::list();
-      for (auto &inlineEntry : funcInfo.inlines) {
-        inlines.push_back(convertInline(inlineEntry));
-      }
-      funcInfoJson["inlines"] = std::move(inlines);
+  if (funcInfo.inlines.size() > 0) {
+    auto inlines = json::list();
+    for (auto &inlineEntry : funcInfo.inlines) {
+      inlines.push_back(convertInline(inlineEntry));
     }
+    funcInfoJson["inlines"] = std::move(inlines);
+  }
 
-    if (funcInfo.loops.size() > 0) {
-      auto loops = json::list();
-      for (auto &loop : funcInfo.loops) {
-        loops.push_back(convertLoopEntry(loop));
-      }
-      funcInfoJson["loops"] = std::move(loops);
+  if (funcInfo.loops.size() > 0) {
+    auto loops = json::list();
+    for (auto &loop : funcInfo.loops) {
+      loops.push_back(convertLoopEntry(loop));
     }
-    if (funcInfo.hidables.size() > 0) {
-      auto hidables = json::list();
-      for (auto &hidable : funcInfo.hidables) {
-        hidables.push_back(convertHidable(hidable));
-      }
-      funcInfoJson["hidables"] = std::move(hidables);
+    funcInfoJson["loops"] = std::move(loops);
+  }
+  if (funcInfo.hidables.size() > 0) {
+    auto hidables = json::list();
+    for (auto &hidable : funcInfo.hidables) {
+      hidables.push_back(convertHidable(hidable));
     }
-    result.push_back(funcInfoJson);
+    funcInfoJson["hidables"] = std::move(hidables);
+  }
+  return funcInfoJson;
+}
+
+json convertFunctionInfos(const std::vector<FunctionInfo> &funcInfos) {
+  auto result = json::list();
+  for (const auto &funcInfo : funcInfos) {
+    result.push_back(convertFunctionInfo(funcInfo));
   }
 
   return result;
-}
\ No newline at end of file
+}
+
+void writeBlocks(std::ostream &o, const std::vector<BlockInfo> &blocks, size_t from, const size_t to) {
+  o << '[';
+  for (auto i = from; i < to; i++) {
+    if (i > from) o << ',';
+    o << convertBlockInfo(blocks[i]).dump();
+  }
+  o << ']';
+}
+
+void writeBinaryJson(std::ostream &o, const BinaryCacheResult *res, const std::vector<FunctionInfo> &funcInfos) {
+  const auto &memory_order_blocks = res->disassembly.memory_order_blocks;
+  const auto &loop_order_blocks = res->disassembly.loop_order_blocks;
+
+  o << "{\"blocks_info\":{\"memory_order_blocks\":";
+  writeBlocks(o, memory_order_blocks, 0, memory_order_blocks.size());
+  o << ",\"loop_order_blocks\":";
+  writeBlocks(o, loop_order_blocks, 0, loop_order_blocks.size());
+  o << ",\"source_files\":" << json(res->source_files).dump() << "},\"functions\":[";
+  for (size_t i = 0; i < funcInfos.size(); i++) {
+    if (i > 0) o << ',';
+    o << convertFunctionInfo(funcInfos[i]).dump();
+  }
+  o << "]}\n";
+}
+
+void writeBinaryJsonLines(std::ostream &o, const BinaryCacheResult *res, const std::vector<FunctionInfo> &funcInfos,
+                          const std::vector<size_t> &functionBlockEnds) {
+  const auto &loop_order_blocks = res->disassembly.loop_order_blocks;
+
+  o << "{\"source_files\":" << json(res->source_files).dump() << "}\n";
+  for (size_t i = 0; i < funcInfos.size(); i++) {
+    auto funcInfoJson = convertFunctionInfo(funcInfos[i]).dump();
+    // Splice the blocks in before the closing brace of the function object
+    funcInfoJson.pop_back();
+    o << funcInfoJson << ",\"blocks\":";
+    writeBlocks(o, loop_order_blocks, i > 0 ? functionBlockEnds[i - 1] : 0, functionBlockEnds[i]);
+    o << "}\n";
+  }
+}
@@ -6,21 +6,29 @@
 #define CROW_STATIC_DIRECTORY "templates/static/"
 
 #include <crow.h>
+#include <cstdio>
 #include <crow/common.h>
 #include <crow/http_response.h>
 #include <crow/middlewares/cors.h>
+#include <analysis_cache.hpp>
+#include <binary_catalog.hpp>
+#include <compression.hpp>
 #include <dyninst_wrapper.hpp>
 #include <filesystem>
 #include <json_converter.hpp>
+#include <msgpack_converter.hpp>
+#include <msgpack_writer.hpp>
+#include <limits>
 #include <numeric>
+#include <optional>
+#include <page_cache.hpp>
+#include <source_files.hpp>
 #include <string>
+#include <thread>
 
 using json = crow::json::wvalue;
 namespace po = boost::program_options;
 
-#define BLOCKS_PER_PAGE 100
-
-enum BLOCK_ORDER { MEMORY_ORDER, LOOP_ORDER };
 BLOCK_ORDER getBlockOrder(std::string order) {
   if (order == "memory_order")
     return MEMORY_ORDER;
@@ -28,12 +36,133 @@ BLOCK_ORDER getBlockOrder(std::string order) {
     return LOOP_ORDER;
 }
 
+json analysisStatusJson(const AnalysisStatus &status) {
+  static const char *phaseNames[] = {"queued", "loading", "parsing", "analyzing", "saving", "done", "failed"};
+  return json({
+    {"phase", phaseNames[status.phase]},
+    {"functions_done", status.functionsDone},
+    {"functions_total", status.functionsTotal},
+    {"queryable", status.queryable},
+    {"ready", status.isReady()},
+  });
+}
+
+// The answer of a data endpoint while the analysis of binaryPath can not serve it yet:
+// 202 with the analysis status, or 404 once the analysis failed. Empty when the endpoint
+// can proceed, which for needsResult endpoints means the whole result is available.
+std::optional<crow::response> pendingResponse(const std::string &binaryPath, const bool saveJson, const bool needsResult) {
+  const auto status = getAnalysisStatus(binaryPath, saveJson);
+  if (status.phase == PHASE_FAILED) return crow::response(crow::NOT_FOUND);
+  if (needsResult ? status.isReady() : status.queryable) return std::nullopt;
+  auto res = crow::response(crow::ACCEPTED);
+  res.body = analysisStatusJson(status).dump();
+  res.set_header("Content-Type", "application/json");
+  res.set_header("Retry-After", "1");
+  return res;
+}
+
+// Disassembly and minimap responses are MessagePack when the request accepts it
+enum ENCODING { ENCODING_JSON, ENCODING_MSGPACK };
+
+ENCODING getEncoding(const crow::request &req) {
+  if (req.get_header_value("Accept").find(MSGPACK_MIME) != std::string::npos)
+    return ENCODING_MSGPACK;
+  return ENCODING_JSON;
+}
+
+CONTENT_CODING getContentCoding(const crow::request &req) {
+  return chooseContentCoding(req.get_header_value("Accept-Encoding"));
+}
+
+// Strong ETag of a response derived from the content hash of the binary. Each
+// representation of resource, by encoding and content coding, has its own.
+std::string makeETag(const uint64_t binaryHash, const std::string &resource, const ENCODING encoding, const CONTENT_CODING coding) {
+  char etag[64];
+  snprintf(etag, sizeof(etag), "\"%016llx-%016zx-%d.%d.%d\"", (unsigned long long)binaryHash,
+           std::hash<std::string>()(resource), ANALYSIS_CACHE_VERSION, encoding, coding);
+  return etag;
+}
+
+// The ETag from If-None-Match that is still current for resource, or an empty string.
+// Bodies too small to compress are sent as identity whatever the coding asked for.
+std::string currentETag(const crow::request &req, const uint64_t binaryHash, const std::string &resource,
+                        const ENCODING encoding, const CONTENT_CODING coding) {
+  const auto &ifNoneMatch = req.get_header_value("If-None-Match");
+  if (binaryHash == 0 || ifNoneMatch.empty()) return "";
+  for (const auto candidate : {coding, CODING_IDENTITY}) {
+    auto etag = makeETag(binaryHash, resource, encoding, candidate);
+    if (ifNoneMatch.find(etag) != std::string::npos) return etag;
+  }
+  return "";
+}
+
+crow::response notModifiedResponse(const std::string &etag) {
+  auto res = crow::response(crow::NOT_MODIFIED);
+  res.set_header("ETag", etag);
+  return res;
+}
+
+crow::response encodedResponse(const ENCODING encoding, const EncodedBody &body, const std::string &etag) {
+  auto res = crow::response(crow::OK);
+  res.body = body.data;
+  res.set_header("Content-Type", encoding == ENCODING_MSGPACK ? MSGPACK_MIME : "application/json");
+  if (body.coding != CODING_IDENTITY) res.set_header("Content-Encoding", contentCodingName(body.coding));
+  res.set_header("Vary", "Accept, Accept-Encoding");
+  if (!etag.empty()) res.set_header("ETag", etag);
+  return res;
+}
+
+// Answers with 304 when the client already has resource of the binary with binaryHash,
+// otherwise with makeBody() compressed as the client accepts. A zero binaryHash sends no ETag.
+template <typename MakeBody>
+crow::response validatedResponse(const crow::request &req, const uint64_t binaryHash, const std::string &resource,
+                                 const ENCODING encoding, MakeBody makeBody) {
+  const auto coding = getContentCoding(req);
+  if (auto etag = currentETag(req, binaryHash, resource, encoding, coding); !etag.empty())
+    return notModifiedResponse(etag);
+  auto body = encodeBody(makeBody(), coding);
+  return encodedResponse(encoding, body, binaryHash ? makeETag(binaryHash, resource, encoding, body.coding) : "");
+}
+
+std::string encodePage(const ENCODING encoding, const DisassemblyPage &page) {
+  return encoding == ENCODING_MSGPACK ? packDisassemblyPage(page) : serializeDisassemblyPage(page);
+}
+
+std::string encodeBlock(const ENCODING encoding, const DisassemblyBlock &block) {
+  return encoding == ENCODING_MSGPACK ? packBlockInfo(*block.block) : serializeDisassemblyBlock(block);
+}
+
+// Encodes page, reusing the cached body when the page belongs to a finished analysis.
+// Without a content hash the pages of a changed binary can not be told apart, so they are not cached.
+crow::response pageResponse(PageCache &pageCache, const crow::request &req, const std::string &binaryPath,
+                            const BLOCK_ORDER order, const DisassemblyPage &page) {
+  const auto encoding = getEncoding(req);
+  const auto coding = getContentCoding(req);
+  if (!page.isFinal() || page.binaryHash == 0)
+    return encodedResponse(encoding, encodeBody(encodePage(encoding, page), coding), "");
+
+  const auto resource = "page/" + std::to_string(order) + "/" + std::to_string(page.pageNo);
+  if (auto etag = currentETag(req, page.binaryHash, resource, encoding, coding); !etag.empty())
+    return notModifiedResponse(etag);
+
+  auto key = PageCache::Key(binaryPath, page.binaryHash, order, page.pageNo, encoding, coding);
+  auto body = pageCache.get(key);
+  if (!body) {
+    body = std::make_shared<const EncodedBody>(encodeBody(encodePage(encoding, page), coding));
+    pageCache.put(key, body);
+  }
+  return encodedResponse(encoding, *body, makeETag(page.binaryHash, resource, encoding, body->coding));
+}
+
 int main(int argc, char *argv[]) {
   auto WRITE_TO_JSON = false;
   auto binary_paths = std::vector<std::string>();
   auto binary_paths_file = std::string();
   auto port = int();
   auto no_server = false;
+  auto server_threads = (unsigned int)1;
+  auto cache_memory_limit = size_t(0);
+  auto analysis_options = AnalysisOptions();
   
   auto desc = po::options_description("Allowed options");
   desc.add_options()
@@ -43,6 +172,12 @@ int main(int argc, char *argv[]) {
     ("binary-paths-file,c", po::value(&binary_paths_file), "A file containing the paths to binary files to visualize")
     ("no-server", po::bool_switch(&no_server), "Don't run the server")
     ("port,p", po::value(&port)->default_value(8080), "The port to run the server on")
+    ("server-threads", po::value(&server_threads)->default_value(1), "Number of threads answering requests (0 uses all cores)")
+    ("analysis-threads", po::value(&analysis_options.analysisThreads)->default_value(1), "Number of threads used to analyze the functions of a binary (0 uses all cores)")
+    ("cache-dir", po::value(&analysis_options.cacheDir), "Directory to load and save analysis results, keyed by the binary's content hash")
+    ("lazy-analysis", po::bool_switch(&analysis_options.lazy), "Analyze functions in the background and answer requests as soon as the functions they need are done")
+    ("json-lines", po::bool_switch(&analysis_options.jsonLines), "With --save-json, write JSON Lines with one record per function")
+    ("cache-memory-limit", po::value(&cache_memory_limit)->default_value(0), "MiB of analysis results kept in memory before the least recently used are evicted (0 is unlimited). Evicted binaries are reloaded from --cache-dir, or analyzed again without it")
   ;
   
   // TODO: Make binary-paths also a positional argument
@@ -60,6 +195,8 @@ int main(int argc, char *argv[]) {
     std::cout << desc << std::endl;
     return 0;
   }
+  analysis_options.cacheMemoryLimit = cache_memory_limit << 20;
+  setAnalysisOptions(analysis_options);
   
   // Read all lines from binary_paths_file and append them to binary_paths
   if(!binary_paths_file.empty()){
@@ -70,285 +207,209 @@ int main(int argc, char *argv[]) {
     }
   }
   
+  auto catalog = BinaryCatalog(binary_paths);
+
   if(no_server) {
-    auto binaryList = std::vector<std::pair<std::string, std::string>>();
-    for (const auto &binary_path : binary_paths) {
-      // Check if binary_path is a directory or a file
-      if (std::filesystem::is_directory(binary_path)) {
-        for (const auto &entry : std::filesystem::directory_iterator(binary_path)) {
-          if (isParsable(entry.path().string()))
-            binaryList.push_back({entry.path().filename().string(), entry.path().string()});
-        }
-      } else {
-        if(!isParsable(binary_path)) continue;
-        binaryList.push_back({std::filesystem::path(binary_path).filename().string(), binary_path});
-      }
-    }
-    
-    for(const auto &binary: binaryList) {
-      decodeBinaryCache(binary.second, WRITE_TO_JSON);
+    for(const auto &binary: catalog.list()) {
+      decodeBinaryCache(binary.path, WRITE_TO_JSON);
     }
 
     return 0;
   }
 
+  auto pageCache = PageCache(64 << 20);
+  auto sourceCache = SourceCache();
+
   auto app = crow::App<crow::CORSHandler>();
   app.get_middleware<crow::CORSHandler>().global();
   // crow::mustache::set_global_base("static/static");
 
   CROW_ROUTE(app, "/api/binarylist")
-      .methods("GET"_method)([&binary_paths](const crow::request &req) {
+      .methods("GET"_method)([&catalog](const crow::request &req) {
         
         auto binaryList = json::list();
-        for (const auto &binary_path : binary_paths) {
-          // Check if binary_path is a directory or a file
-          if (std::filesystem::is_directory(binary_path)) {
-            for (const auto &entry :
-                 std::filesystem::directory_iterator(binary_path)) {
-
-              if (isParsable(entry.path().string())) {
-                auto binary = json({
-                    {"name", entry.path().filename().string()},
-                    {"executable_path", entry.path().string()},
-                });
-                binaryList.push_back(binary);
-              }
-            }
-          } else {
-            if(!isParsable(binary_path)){
-              continue;
-            }
-            auto binary = json({
-                {"name", std::filesystem::path(binary_path).filename().string()},
-                {"executable_path", binary_path},
-            });
-            binaryList.push_back(binary);
-          }
+        for (const auto &binary : catalog.list()) {
+          binaryList.push_back(json({
+              {"name", binary.name},
+              {"executable_path", binary.path},
+          }));
         }
 
         json payload = json({{"binarylist", binaryList}});
         return payload;
       });
   
+  // Starts the analysis of a binary and reports its progress. Data endpoints answer
+  // 202 with the same status until they can serve the binary.
+  CROW_ROUTE(app, "/api/analysisstatus")
+      .methods("POST"_method)([&WRITE_TO_JSON](const crow::request &req) {
+        auto reqBody = crow::json::load(req.body);
+        auto binaryPath = reqBody["path"].s();
+        return analysisStatusJson(getAnalysisStatus(binaryPath, WRITE_TO_JSON));
+      });
+
   CROW_ROUTE(app, "/api/getdisassemblypage/<string>/<int>")
-      .methods("POST"_method)([&WRITE_TO_JSON](const crow::request &req,
-                                 const std::string order, const int pageNo) {
+      .methods("POST"_method)([&WRITE_TO_JSON, &pageCache](const crow::request &req,
+                                 const std::string order, const int pageNo) -> crow::response {
         auto reqBody = crow::json::load(req.body);
         auto binaryPath = reqBody["path"].s();
 
-        std::vector<BlockInfo> *assembly;
-        if (getBlockOrder(order) == MEMORY_ORDER)
-          assembly =
-              &decodeBinaryCache(binaryPath, WRITE_TO_JSON)->disassembly.memory_order_blocks;
-        else
-          assembly =
-              &decodeBinaryCache(binaryPath, WRITE_TO_JSON)->disassembly.loop_order_blocks;
-
-        auto start = pageNo * BLOCKS_PER_PAGE;
-        auto end = start + BLOCKS_PER_PAGE;
-        auto is_last = false;
-        if (end >= assembly->size()) {
-          end = assembly->size();
-          is_last = true;
-        }
-        auto page = std::vector<BlockInfo>(assembly->begin() + start,
-                                    assembly->begin() + end);
-        auto pageJson = json::list();
-        for (const auto &i : page) {
-          pageJson.push_back(convertBlockInfo(i));
-        }
-        auto n_instructions = std::accumulate(
-            page.begin(), page.end(), 0,
-            [](int sum, const BlockInfo &i) { return sum + i.nInstructions; });
-        
-        auto result = json({{"end_address", page.back().endAddress},
-                     {"is_last", is_last},
-                     {"blocks", pageJson},
-                     {"n_instructions", n_instructions},
-                     {"page_no", pageNo},
-                     {"start_address", page.front().startAddress}});
-        return result;
+        if (auto pending = pendingResponse(binaryPath, WRITE_TO_JSON, false)) return std::move(*pending);
+        auto page = DisassemblyPage();
+        if (!getDisassemblyPage(binaryPath, WRITE_TO_JSON, getBlockOrder(order), pageNo, page))
+          return crow::response(crow::NOT_FOUND);
+        return pageResponse(pageCache, req, binaryPath, getBlockOrder(order), page);
       });
 
   CROW_ROUTE(app, "/api/getdisassemblypagebyaddress/<string>/<int>")
-      .methods("POST"_method)([&WRITE_TO_JSON](const crow::request &req, std::string order,
-                                 int address) {
+      .methods("POST"_method)([&WRITE_TO_JSON, &pageCache](const crow::request &req, std::string order,
+                                 int address) -> crow::response {
         auto reqBody = crow::json::load(req.body);
         auto binaryPath = reqBody["path"].s();
 
-        std::vector<BlockInfo> *assembly;
-        if (getBlockOrder(order) == MEMORY_ORDER)
-          assembly =
-              &decodeBinaryCache(binaryPath, WRITE_TO_JSON)->disassembly.memory_order_blocks;
-        else
-          assembly =
-              &decodeBinaryCache(binaryPath, WRITE_TO_JSON)->disassembly.loop_order_blocks;
-
-        auto start = -1;
-        auto pageNo = 0;
-        for (int i = 0; i < assembly->size(); i += BLOCKS_PER_PAGE) {
-          for (int j = i; j < i + BLOCKS_PER_PAGE; j++) {
-            if (assembly->at(j).startAddress <= address &&
-                assembly->at(j).endAddress >= address) {
-              start = i;
-              break;
-            }
-          }
-          if (start != -1)
-            break;
-          pageNo++;
-        }
-        if (start == -1)
-          start = 0;
-        auto end = start + BLOCKS_PER_PAGE;
-        auto is_last = false;
-        if (end >= assembly->size()) {
-          is_last = true;
-          end = assembly->size();
-        }
-        auto page = std::vector<BlockInfo>(assembly->begin() + start,
-                                    assembly->begin() + end);
-        auto pageJson = json::list();
-        for (const auto &i : page) {
-          pageJson.push_back(convertBlockInfo(i));
-        }
-        int n_instructions = std::accumulate(
-            page.begin(), page.end(), 0,
-            [](int sum, const BlockInfo &i) { return sum + i.nInstructions; });
-        auto result = json({{"end_address", page.back().endAddress},
-                     {"is_last", is_last},
-                     {"blocks", pageJson},
-                     {"n_instructions", n_instructions},
-                     {"page_no", pageNo},
-                     {"start_address", page.front().startAddress}});
-        return result;
+        if (auto pending = pendingResponse(binaryPath, WRITE_TO_JSON, false)) return std::move(*pending);
+        auto page = DisassemblyPage();
+        if (!getDisassemblyPageByAddress(binaryPath, WRITE_TO_JSON, getBlockOrder(order), address, page))
+          return crow::response(crow::NOT_FOUND);
+        return pageResponse(pageCache, req, binaryPath, getBlockOrder(order), page);
       });
 
   CROW_ROUTE(app, "/api/sourcefiles")
-      .methods("POST"_method)([&WRITE_TO_JSON](const crow::request &req) {
+      .methods("POST"_method)([&WRITE_TO_JSON](const crow::request &req) -> crow::response {
         auto reqBody = crow::json::load(req.body);
         auto binaryPath = reqBody["path"].s();
 
-        const auto &sourceFiles = decodeBinaryCache(binaryPath, WRITE_TO_JSON)->source_files;
-        auto sourceFilesJson = json::list();
-        for (const auto &i : sourceFiles) {
-          sourceFilesJson.push_back({{"file", i}});
-        }
-        return json(sourceFilesJson);
+        if (auto pending = pendingResponse(binaryPath, WRITE_TO_JSON, true)) return std::move(*pending);
+        const auto res = decodeBinaryCache(binaryPath, WRITE_TO_JSON);
+        if (!res)
+          return crow::response(crow::NOT_FOUND);
+        return validatedResponse(req, res->binary_hash, "sourcefiles", ENCODING_JSON, [res] {
+          auto sourceFilesJson = json::list();
+          for (const auto &i : res->source_files) {
+            sourceFilesJson.push_back({{"file", i}});
+          }
+          return json(sourceFilesJson).dump();
+        });
       });
 
   CROW_ROUTE(app, "/api/getminimapdata/<string>")
-      .methods("POST"_method)([&WRITE_TO_JSON](const crow::request &req, std::string order) {
+      .methods("POST"_method)([&WRITE_TO_JSON](const crow::request &req, std::string order) -> crow::response {
+        auto reqBody = crow::json::load(req.body);
+        auto binaryPath = reqBody["path"].s();
+
+        if (auto pending = pendingResponse(binaryPath, WRITE_TO_JSON, true)) return std::move(*pending);
+        const auto res = decodeBinaryCache(binaryPath, WRITE_TO_JSON);
+        if (!res)
+          return crow::response(crow::NOT_FOUND);
+        const auto &minimap = getBlockOrder(order) == MEMORY_ORDER ? res->minimap.memory_order : res->minimap.loop_order;
+        const auto encoding = getEncoding(req);
+        return validatedResponse(req, res->binary_hash, "minimap/" + order, encoding, [&minimap, encoding] {
+          return encoding == ENCODING_MSGPACK ? packMinimapInfo(minimap) : convertMinimapInfo(minimap).dump();
+        });
+      });
+
+  // The minimap of the blocks [start_block, end_block) of an order, or of the blocks containing
+  // [start_address, end_address], at the finest level that fits in max_buckets buckets
+  CROW_ROUTE(app, "/api/getminimaptile/<string>")
+      .methods("POST"_method)([&WRITE_TO_JSON](const crow::request &req, std::string order) -> crow::response {
         auto reqBody = crow::json::load(req.body);
         auto binaryPath = reqBody["path"].s();
 
-        auto minimap = decodeBinaryCache(binaryPath, WRITE_TO_JSON)->minimap;
-        auto payload = json();
-        if (getBlockOrder(order) == MEMORY_ORDER) {
-          payload = convertMinimapInfo(minimap.memory_order);
+        if (auto pending = pendingResponse(binaryPath, WRITE_TO_JSON, true)) return std::move(*pending);
+        const auto res = decodeBinaryCache(binaryPath, WRITE_TO_JSON);
+        if (!res)
+          return crow::response(crow::NOT_FOUND);
+
+        auto startBlock = size_t(0);
+        auto endBlock = std::numeric_limits<size_t>::max();
+        if (reqBody.has("start_address") && reqBody.has("end_address")) {
+          getBlockRange(*res, getBlockOrder(order), reqBody["start_address"].u(), reqBody["end_address"].u(), startBlock, endBlock);
         } else {
-          payload = convertMinimapInfo(minimap.loop_order);
+          if (reqBody.has("start_block")) startBlock = std::max<int64_t>(reqBody["start_block"].i(), 0);
+          if (reqBody.has("end_block")) endBlock = std::max<int64_t>(reqBody["end_block"].i(), 0);
         }
-        return payload;
+        const auto maxBuckets = reqBody.has("max_buckets") ? std::max<int64_t>(reqBody["max_buckets"].i(), 1) : 1024;
+
+        auto tile = MinimapTile();
+        if (!getMinimapTile(*res, getBlockOrder(order), startBlock, endBlock, maxBuckets, tile))
+          return crow::response(crow::NOT_FOUND);
+        const auto encoding = getEncoding(req);
+        auto resource = "minimaptile/" + order + "/" + std::to_string(tile.levelNo) + "/" +
+                        std::to_string(tile.startBucket) + "-" + std::to_string(tile.endBucket);
+        return validatedResponse(req, res->binary_hash, resource, encoding, [&tile, encoding] {
+          return encoding == ENCODING_MSGPACK ? packMinimapTile(tile) : convertMinimapTile(tile).dump();
+        });
       });
 
+  // Lines [start_line, end_line) of a source file, 0-based, with the addresses of each line.
+  // Without a range the whole file is sent.
   CROW_ROUTE(app, "/api/getsourcefile")
-      .methods("POST"_method)([&WRITE_TO_JSON](const crow::request &req) {
+      .methods("POST"_method)([&WRITE_TO_JSON, &sourceCache](const crow::request &req) -> crow::response {
         const auto &reqBody = crow::json::load(req.body);
         const auto &binaryPath = reqBody["binary_file_path"]["path"].s();
         const auto &sourceFile = reqBody["filepath"]["path"].s();
 
+        if (auto pending = pendingResponse(binaryPath, WRITE_TO_JSON, true)) return std::move(*pending);
         const auto &decodedBinary = decodeBinaryCache(binaryPath, WRITE_TO_JSON);
-        auto &correspondences = decodedBinary->correspondences[sourceFile];
-        auto sourceCodeInfo = std::map<int, std::unordered_set<SourceCodeTags>>();
-        if(decodedBinary->sourceCodeInfo.find(sourceFile) != decodedBinary->sourceCodeInfo.end()){
-          sourceCodeInfo = decodedBinary->sourceCodeInfo[sourceFile];          
-        }
-
-        auto lines = json::list();
-        auto ifs = std::ifstream(sourceFile);
-        
-        for (auto [lineNo, line] = std::tuple{0, std::string()}; std::getline(ifs, line); lineNo++) {
-          auto addresses = json::list();
-          std::copy(correspondences[lineNo].begin(),
-                    correspondences[lineNo].end(),
-                    std::back_inserter(addresses));
-          auto tags = json::list();
-          auto tagsToStr = std::unordered_map<SourceCodeTags, std::string>({
-            {SourceCodeTags::INLINE_TAG, "INLINE"},
-            {SourceCodeTags::VECTORIZED_TAG, "VECTORIZED"}
-          });
-          if(sourceCodeInfo.find(lineNo) != sourceCodeInfo.end()){
-            for(const auto &tag: sourceCodeInfo[lineNo]){
-              tags.push_back(tagsToStr[tag]);
-            }
-          }
-          lines.push_back({
-              {"line", line + "\n"},
-              {"addresses", addresses},
-              {"tags", tags}
-          });
-        }
-        auto payload = json({
-            {"lines", std::move(lines)},
+        if (!decodedBinary)
+          return crow::response(crow::NOT_FOUND);
+
+        const auto text = sourceCache.text(sourceFile);
+        const auto lineCount = text->lineCount();
+        const auto startLine = reqBody.has("start_line") ? std::min<size_t>(std::max<int64_t>(reqBody["start_line"].i(), 0), lineCount) : 0;
+        const auto endLine = reqBody.has("end_line") ? std::clamp<size_t>(std::max<int64_t>(reqBody["end_line"].i(), 0), startLine, lineCount) : lineCount;
+
+        // The source file can change independently of the binary
+        auto resource = "sourcefile/" + std::string(sourceFile) + "/" + std::to_string(text->size()) + "/" +
+                        std::to_string(text->modified().time_since_epoch().count()) + "/" +
+                        std::to_string(startLine) + "-" + std::to_string(endLine);
+        auto binaryHash = text->exists() ? decodedBinary->binary_hash : 0;
+        return validatedResponse(req, binaryHash, resource, ENCODING_JSON, [&] {
+          return serializeSourceLines(*text, *sourceCache.lineIndex(*decodedBinary, sourceFile), startLine, endLine);
         });
-        return payload;
       });
 
   CROW_ROUTE(app, "/api/getdisassemblyblockbyid/<string>")
-      .methods("POST"_method)([&WRITE_TO_JSON](const crow::request &req, std::string order) {
+      .methods("POST"_method)([&WRITE_TO_JSON](const crow::request &req, std::string order) -> crow::response {
         auto reqBody = crow::json::load(req.body);
         auto binaryPath = reqBody["path"].s();
         auto id = reqBody["blockId"].s();
         
-        std::vector<BlockInfo> *assembly;
-        if (getBlockOrder(order) == MEMORY_ORDER)
-          assembly =
-              &decodeBinaryCache(binaryPath, WRITE_TO_JSON)->disassembly.memory_order_blocks;
-        else
-          assembly =
-              &decodeBinaryCache(binaryPath, WRITE_TO_JSON)->disassembly.loop_order_blocks;
-              
-        auto block =
-            *std::find_if(assembly->begin(), assembly->end(),
-                          [&id](const BlockInfo &i) { return i.name == id; });
-
-        return convertBlockInfo(block);
+        if (auto pending = pendingResponse(binaryPath, WRITE_TO_JSON, false)) return std::move(*pending);
+        auto block = DisassemblyBlock();
+        if (!getDisassemblyBlockById(binaryPath, WRITE_TO_JSON, getBlockOrder(order), id, block))
+          return crow::response(crow::NOT_FOUND);
+        const auto encoding = getEncoding(req);
+        return validatedResponse(req, block.binaryHash, "blockbyid/" + order + "/" + id, encoding,
+                                 [&block, encoding] { return encodeBlock(encoding, block); });
       });
   
 
   CROW_ROUTE(app, "/api/getdisassemblyblockbyaddress/<string>")
-      .methods("POST"_method)([&WRITE_TO_JSON](const crow::request &req, std::string order) {
+      .methods("POST"_method)([&WRITE_TO_JSON](const crow::request &req, std::string order) -> crow::response {
         auto reqBody = crow::json::load(req.body);
         auto binaryPath = reqBody["path"].s();
         auto blockStartAddress = reqBody["blockStartAddress"].i();
         
-        std::vector<BlockInfo> *assembly;
-        if (getBlockOrder(order) == MEMORY_ORDER)
-          assembly =
-              &decodeBinaryCache(binaryPath, WRITE_TO_JSON)->disassembly.memory_order_blocks;
-        else
-          assembly =
-              &decodeBinaryCache(binaryPath, WRITE_TO_JSON)->disassembly.loop_order_blocks;
-
-        auto block = *std::find_if(assembly->begin(), assembly->end(),
-                                   [&blockStartAddress](const BlockInfo &i) {
-                                     return i.startAddress == blockStartAddress;
-                                   });
-
-        return convertBlockInfo(block);
+        if (auto pending = pendingResponse(binaryPath, WRITE_TO_JSON, false)) return std::move(*pending);
+        auto block = DisassemblyBlock();
+        if (!getDisassemblyBlockByAddress(binaryPath, WRITE_TO_JSON, getBlockOrder(order), blockStartAddress, block))
+          return crow::response(crow::NOT_FOUND);
+        const auto encoding = getEncoding(req);
+        return validatedResponse(req, block.binaryHash, "blockbyaddress/" + order + "/" + std::to_string(blockStartAddress), encoding,
+                                 [&block, encoding] { return encodeBlock(encoding, block); });
       });
 
     CROW_ROUTE(app, "/api/addressrange")
-      .methods("POST"_method)([&WRITE_TO_JSON](const crow::request &req) {
+      .methods("POST"_method)([&WRITE_TO_JSON](const crow::request &req) -> crow::response {
         auto reqBody = crow::json::load(req.body);
         auto binaryPath = reqBody["path"].s();
 
-        std::vector<BlockInfo> *assembly =
-              &decodeBinaryCache(binaryPath, WRITE_TO_JSON)->disassembly.memory_order_blocks;
-
-        auto minAddress = std::ranges::min_element(assembly->begin(), assembly->end(), [](BlockInfo &a, BlockInfo &b) { return a.startAddress < b.startAddress; })->startAddress;
-        auto maxAddress = std::ranges::max_element(assembly->begin(), assembly->end(), [](BlockInfo &a, BlockInfo &b) { return a.startAddress < b.startAddress; })->endAddress;
+        if (auto pending = pendingResponse(binaryPath, WRITE_TO_JSON, false)) return std::move(*pending);
+        auto minAddress = int();
+        auto maxAddress = int();
+        if (!getAddressRange(binaryPath, WRITE_TO_JSON, minAddress, maxAddress))
+          return crow::response(crow::NOT_FOUND);
 
         return json({
           {"start", minAddress},
@@ -381,8 +442,9 @@ int main(int argc, char *argv[]) {
   // Preload all binary cache
   // decodeBinaryCache("/api/home/insane/prapti/RAJAPerf/build_ubuntu-gcc-12/bin/raja-perf.exe", WRITE_TO_JSON);
 
+  if (server_threads == 0) server_threads = std::max(1u, std::thread::hardware_concurrency());
   app.port(port)
-      // .multithreaded() // This does not work now because of all the global
-      // variables in dyninst_wrapper
+      // Crow keeps one of its threads for accepting connections
+      .concurrency(server_threads + 1)
       .run();
 }
\ No newline at end of file
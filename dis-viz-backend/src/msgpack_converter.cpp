@@ -0,0 +1,189 @@
+#include <msgpack_converter.hpp>
+#include <msgpack_writer.hpp>
+
+void packVariableInfo(MsgpackWriter &w, const VariableInfo &var) {
+  w.map(5);
+  w.str("name");
+  w.str(var.name);
+  w.str("source_file");
+  w.str(var.file);
+  w.str("source_line");
+  w.integer(var.line);
+  w.str("locations");
+  w.array(var.locations.size());
+  for (const auto &i : var.locations) {
+    w.map(3);
+    w.str("start_address");
+    w.uinteger(i.start);
+    w.str("end_address");
+    w.uinteger(i.end);
+    w.str("location");
+    w.str(i.location);
+  }
+  w.str("var_type");
+  w.integer(var.var_type);
+}
+
+void packInstructionInfo(MsgpackWriter &w, const InstructionInfo &instruction) {
+  static const char *flagNames[] = {"INST_VECTORIZED", "INST_MEMORY_READ", "INST_MEMORY_WRITE",
+                                    "INST_CALL", "INST_SYSCALL", "INST_FP"};
+  w.map(3 + !instruction.correspondence.empty() + !instruction.variables.empty());
+  w.str("address");
+  w.uinteger(instruction.address);
+  w.str("instruction");
+  w.str(instruction.instruction);
+
+  if (!instruction.correspondence.empty()) {
+    w.str("correspondence");
+    w.map(instruction.correspondence.size());
+    for (const auto &[file, lines] : instruction.correspondence) {
+      w.str(file);
+      w.array(lines.size());
+      for (const auto line : lines) w.integer(line);
+    }
+  }
+
+  if (!instruction.variables.empty()) {
+    w.str("variables");
+    w.array(instruction.variables.size());
+    for (const auto &i : instruction.variables) packVariableInfo(w, i);
+  }
+
+  auto nFlags = 0;
+  for (int flag = INST_VECTORIZED; flag <= INST_FP; flag++) nFlags += instruction.flags.contains(INSTRUCTION_FLAGS(flag));
+  w.str("flags");
+  w.array(nFlags);
+  for (int flag = INST_VECTORIZED; flag <= INST_FP; flag++) {
+    if (instruction.flags.contains(INSTRUCTION_FLAGS(flag))) w.str(flagNames[flag]);
+  }
+}
+
+void packStrings(MsgpackWriter &w, const std::vector<std::string> &strings) {
+  w.array(strings.size());
+  for (const auto &i : strings) w.str(i);
+}
+
+void packBlockInfo(MsgpackWriter &w, const BlockInfo &block) {
+  w.map(11 + !block.hidables.empty());
+  w.str("name");
+  w.str(block.name);
+  w.str("function_name");
+  w.str(block.functionName);
+  w.str("instructions");
+  w.array(block.instructions.size());
+  for (const auto &i : block.instructions) packInstructionInfo(w, i);
+  w.str("loops");
+  w.array(block.loops.size());
+  for (const auto &i : block.loops) {
+    w.map(3);
+    w.str("name");
+    w.str(i.name);
+    w.str("loop_count");
+    w.integer(i.loopCount);
+    w.str("loop_total");
+    w.integer(i.loopTotal);
+  }
+  w.str("block_type");
+  w.str(block.block_type == BlockInfo::BLOCK_TYPE_PSEUDOLOOP ? "pseudoloop" : "normal");
+  w.str("backedges");
+  packStrings(w, block.backedges);
+
+  if (!block.hidables.empty()) {
+    w.str("hidables");
+    w.array(block.hidables.size());
+    for (const auto &i : block.hidables) {
+      w.map(3);
+      w.str("name");
+      w.str(i.name);
+      w.str("start_address");
+      w.uinteger(i.start);
+      w.str("end_address");
+      w.uinteger(i.end);
+    }
+  }
+  w.str("next_block_numbers");
+  packStrings(w, block.nextBlockNames);
+  w.str("start_address");
+  w.integer(block.startAddress);
+  w.str("end_address");
+  w.integer(block.endAddress);
+  w.str("n_instructions");
+  w.integer(block.nInstructions);
+  w.str("is_loop_header");
+  w.boolean(block.isLoopHeader);
+}
+
+std::string packBlockInfo(const BlockInfo &block) {
+  auto w = MsgpackWriter();
+  packBlockInfo(w, block);
+  return w.take();
+}
+
+std::string packDisassemblyPage(const DisassemblyPage &page) {
+  auto w = MsgpackWriter();
+  auto n_instructions = 0;
+  for (const auto &i : page.blocks) n_instructions += i.nInstructions;
+
+  w.map(6);
+  w.str("end_address");
+  w.integer(page.blocks.back().endAddress);
+  w.str("is_last");
+  w.boolean(page.isLast);
+  w.str("blocks");
+  w.array(page.blocks.size());
+  for (const auto &i : page.blocks) packBlockInfo(w, i);
+  w.str("n_instructions");
+  w.integer(n_instructions);
+  w.str("page_no");
+  w.integer(page.pageNo);
+  w.str("start_address");
+  w.integer(page.blocks.front().startAddress);
+  return w.take();
+}
+
+std::string packMinimapTile(const MinimapTile &tile) {
+  const auto &level = *tile.level;
+  const auto window = [&tile](const std::vector<int> &values) {
+    return std::span(values).subspan(tile.startBucket, tile.endBucket - tile.startBucket);
+  };
+  auto w = MsgpackWriter();
+  w.map(10);
+  w.str("level");
+  w.integer(tile.levelNo);
+  w.str("bucket_blocks");
+  w.integer(level.bucket_blocks);
+  w.str("start_bucket");
+  w.uinteger(tile.startBucket);
+  w.str("n_buckets");
+  w.uinteger(level.start_address.size());
+  w.str("start_address");
+  w.int32Array(window(level.start_address));
+  w.str("instructions");
+  w.int32Array(window(level.instructions));
+  w.str("built_in_blocks");
+  w.int32Array(window(level.built_in_blocks));
+  w.str("loop_depth");
+  w.int32Array(window(level.loop_depth));
+  w.str("type_bits");
+  w.int32Array(window(level.type_bits));
+  w.str("dominant_type");
+  w.int32Array(window(level.dominant_type));
+  return w.take();
+}
+
+std::string packMinimapInfo(const MinimapInfo &minimap) {
+  auto w = MsgpackWriter();
+  w.map(5);
+  w.str("block_heights");
+  w.int32Array(minimap.block_heights);
+  w.str("built_in_block");
+  w.boolArray(minimap.built_in_blocks);
+  w.str("block_start_address");
+  w.int32Array(minimap.block_start_address);
+  w.str("block_loop_indents");
+  w.int32Array(minimap.block_loop_indents);
+  w.str("block_types");
+  w.array(minimap.block_types.size());
+  for (const auto &i : minimap.block_types) packStrings(w, i);
+  return w.take();
+}
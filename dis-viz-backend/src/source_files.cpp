@@ -0,0 +1,171 @@
+#include <source_files.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+
+namespace fs = std::filesystem;
+
+SourceText::SourceText(const std::string &path) {
+  auto sizeError = std::error_code();
+  auto timeError = std::error_code();
+  fileSize = fs::file_size(path, sizeError);
+  fileModified = fs::last_write_time(path, timeError);
+  fileExists = !sizeError && !timeError;
+
+  lineStarts.push_back(0);
+  auto ifs = std::ifstream(path, std::ios::binary);
+  if (!fileExists || !ifs) return;
+  // A file that shrank since it was stat'ed is read up to its new end
+  contents.resize(fileSize);
+  ifs.read(contents.data(), contents.size());
+  contents.resize(ifs.gcount());
+  const auto *data = contents.data();
+  const auto *end = data + contents.size();
+  for (auto *p = data; (p = static_cast<const char *>(std::memchr(p, '\n', end - p))); p++)
+    lineStarts.push_back(p + 1 - data);
+  // The last line has no newline
+  if (lineStarts.back() != contents.size()) lineStarts.push_back(contents.size() + 1);
+}
+
+SourceLineIndex makeSourceLineIndex(const BinaryCacheResult &res, const std::string &sourceFile) {
+  static const auto noCorrespondences = std::map<int, std::vector<unsigned long>>();
+  static const auto noSourceCodeInfo = std::map<int, std::unordered_set<SourceCodeTags>>();
+  const auto fileCorrespondences = res.correspondences.find(sourceFile);
+  const auto &correspondences = fileCorrespondences != res.correspondences.end() ? fileCorrespondences->second : noCorrespondences;
+  const auto fileSourceCodeInfo = res.sourceCodeInfo.find(sourceFile);
+  const auto &sourceCodeInfo = fileSourceCodeInfo != res.sourceCodeInfo.end() ? fileSourceCodeInfo->second : noSourceCodeInfo;
+
+  // Both maps are sorted by line, so they are merged
+  auto index = SourceLineIndex();
+  auto lineAddresses = correspondences.begin();
+  auto lineTags = sourceCodeInfo.begin();
+  while (lineAddresses != correspondences.end() || lineTags != sourceCodeInfo.end()) {
+    auto line = std::min(lineAddresses != correspondences.end() ? lineAddresses->first : std::numeric_limits<int>::max(),
+                         lineTags != sourceCodeInfo.end() ? lineTags->first : std::numeric_limits<int>::max());
+    index.lines.push_back(line);
+    index.addressStarts.push_back(index.addresses.size());
+    if (lineAddresses != correspondences.end() && lineAddresses->first == line) {
+      index.addresses.insert(index.addresses.end(), lineAddresses->second.begin(), lineAddresses->second.end());
+      lineAddresses++;
+    }
+    auto tags = uint8_t(0);
+    if (lineTags != sourceCodeInfo.end() && lineTags->first == line) {
+      for (const auto tag : lineTags->second) tags |= 1u << tag;
+      lineTags++;
+    }
+    index.tags.push_back(tags);
+  }
+  index.addressStarts.push_back(index.addresses.size());
+  return index;
+}
+
+void appendJsonString(std::string &out, const std::string_view s) {
+  out += '"';
+  for (const auto c : s) {
+    switch (c) {
+      case '"': out += "\\\""; break;
+      case '\\': out += "\\\\"; break;
+      case '\n': out += "\\n"; break;
+      case '\r': out += "\\r"; break;
+      case '\t': out += "\\t"; break;
+      default:
+        if ((unsigned char)c < 0x20) {
+          char escaped[8];
+          snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+          out += escaped;
+        } else {
+          out += c;
+        }
+    }
+  }
+  out += '"';
+}
+
+std::string serializeSourceLines(const SourceText &text, const SourceLineIndex &index, const size_t startLine, const size_t endLine) {
+  static const char *tagNames[] = {"INLINE", "VECTORIZED"};
+  auto body = std::string();
+  body.reserve(128 + (endLine > startLine ? (endLine - startLine) * 64 : 0));
+  body += "{\"lines\":[";
+  // Index entries before startLine are skipped with a binary search
+  auto entry = size_t(std::lower_bound(index.lines.begin(), index.lines.end(), (int)startLine) - index.lines.begin());
+  for (auto lineNo = startLine; lineNo < endLine; lineNo++) {
+    if (lineNo > startLine) body += ',';
+    body += "{\"line\":";
+    auto line = std::string(text.line(lineNo));
+    line += '\n';
+    appendJsonString(body, line);
+    body += ",\"addresses\":[";
+    auto tags = uint8_t(0);
+    if (entry < index.lines.size() && index.lines[entry] == (int)lineNo) {
+      for (auto a = index.addressStarts[entry]; a < index.addressStarts[entry + 1]; a++) {
+        if (a > index.addressStarts[entry]) body += ',';
+        body += std::to_string(index.addresses[a]);
+      }
+      tags = index.tags[entry++];
+    }
+    body += "],\"tags\":[";
+    for (auto tag = 0, n = 0; tag < 8; tag++) {
+      if (!(tags & (1u << tag))) continue;
+      if (n++ > 0) body += ',';
+      appendJsonString(body, tag < (int)std::size(tagNames) ? tagNames[tag] : "UNKNOWN");
+    }
+    body += "]}";
+  }
+  body += "],\"start_line\":" + std::to_string(startLine);
+  body += ",\"end_line\":" + std::to_string(endLine);
+  body += ",\"total_lines\":" + std::to_string(text.lineCount()) + "}";
+  return body;
+}
+
+template <typename Key, typename T>
+void SourceCache::insert(std::map<Key, Entry<T>> &entries, const Key &key, std::shared_ptr<const T> value) {
+  if (entries.size() >= MAX_ENTRIES && entries.find(key) == entries.end()) {
+    auto oldest = std::min_element(entries.begin(), entries.end(),
+                                   [](const auto &a, const auto &b) { return a.second.lastUse < b.second.lastUse; });
+    entries.erase(oldest);
+  }
+  entries[key] = Entry<T>{std::move(value), ++uses};
+}
+
+std::shared_ptr<const SourceText> SourceCache::text(const std::string &path) {
+  auto sizeError = std::error_code();
+  auto timeError = std::error_code();
+  const auto size = fs::file_size(path, sizeError);
+  const auto modified = fs::last_write_time(path, timeError);
+  {
+    auto lock = std::lock_guard(m);
+    auto it = texts.find(path);
+    if (it != texts.end() && !sizeError && !timeError && it->second.value->exists() &&
+        it->second.value->size() == size && it->second.value->modified() == modified) {
+      it->second.lastUse = ++uses;
+      return it->second.value;
+    }
+  }
+  // Read outside the lock. Two threads may both read a changed file, which is harmless.
+  auto text = std::make_shared<const SourceText>(path);
+  auto lock = std::lock_guard(m);
+  insert(texts, path, std::shared_ptr<const SourceText>(text));
+  return text;
+}
+
+std::shared_ptr<const SourceLineIndex> SourceCache::lineIndex(const BinaryCacheResult &res, const std::string &sourceFile) {
+  // Without a content hash results of different binaries can not be told apart
+  if (res.binary_hash == 0) return std::make_shared<const SourceLineIndex>(makeSourceLineIndex(res, sourceFile));
+  const auto key = std::tuple(res.binary_hash, sourceFile);
+  {
+    auto lock = std::lock_guard(m);
+    auto it = indexes.find(key);
+    if (it != indexes.end()) {
+      it->second.lastUse = ++uses;
+      return it->second.value;
+    }
+  }
+  auto index = std::make_shared<const SourceLineIndex>(makeSourceLineIndex(res, sourceFile));
+  auto lock = std::lock_guard(m);
+  insert(indexes, key, std::shared_ptr<const SourceLineIndex>(index));
+  return index;
+}
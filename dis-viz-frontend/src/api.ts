@@ -1,14 +1,57 @@
-import { getUrls } from './config'
+import { getUrls, USE_MSGPACK, ANALYSIS_POLL_INTERVAL } from './config'
 import { plainToInstance } from 'class-transformer';
 import { BlockPage, SourceFile, InstructionBlock, BLOCK_ORDERS } from './types'
-import { MinimapType } from './features/minimap/minimapSlice';
+import { MinimapType, MinimapTileType } from './features/minimap/minimapSlice';
+import { decode, MSGPACK_MIME } from './msgpack';
 
 
 
 const apiURL = getUrls().backend + '/api/'
 
-export async function getSourceFiles(filepath: string) : Promise<string[]> {
+// Headers of the requests that the backend can answer in MessagePack
+const encodedHeaders = {
+    'Content-Type': 'application/json',
+    'Accept': USE_MSGPACK ? MSGPACK_MIME : 'application/json',
+}
+
+export type AnalysisStatus = {
+    phase: 'queued' | 'loading' | 'parsing' | 'analyzing' | 'saving' | 'done' | 'failed',
+    functions_done: number,
+    functions_total: number,
+    queryable: boolean,
+    ready: boolean,
+}
+
+// Fetches input, retrying while the backend answers 202 because the binary is still being analyzed
+async function fetchAnalyzed(input: string, init: RequestInit): Promise<Response> {
+    for (;;) {
+        const response = await fetch(input, init)
+        if (response.status !== 202) return response
+        await new Promise(resolve => setTimeout(resolve, ANALYSIS_POLL_INTERVAL))
+    }
+}
+
+async function decodeResponse(response: Response): Promise<any> {
+    if (response.headers.get('Content-Type')?.startsWith(MSGPACK_MIME))
+        return decode(await response.arrayBuffer())
+    return response.json()
+}
+
+export async function getAnalysisStatus(filepath: string): Promise<AnalysisStatus> {
     const response = await fetch(
+        apiURL + "analysisstatus", {
+            method: 'POST',
+            headers: {
+                'Content-Type': 'application/json',
+            },
+            body: JSON.stringify({path:filepath}),
+        }
+    );
+    return response.json();
+}
+
+export async function getSourceFiles(filepath: string) : Promise<string[]> {
+    const response = await fetchAnalyzed(
         apiURL + "sourcefiles", {
             method: 'POST',
             headers: {
@@ -22,28 +65,60 @@ export async function getSourceFiles(filepath: string) : Promise<string[]> {
 }
 
 export async function getMinimapData(filepath: string, order: BLOCK_ORDERS) : Promise<MinimapType> {
-    const response = await fetch(
+    const response = await fetchAnalyzed(
         apiURL + "getminimapdata/" + order, {
             method: 'POST',
-            headers: {
-                'Content-Type': 'application/json',
-            },
+            headers: encodedHeaders,
             body: JSON.stringify({path:filepath}),
         }
     );
-    const result = await response.json();
+    const result = await decodeResponse(response);
 
+    // MessagePack sends the numeric arrays packed, JSON as plain arrays
+    const toInt32Array = (a: Int32Array | number[]) => a instanceof Int32Array ? a : Int32Array.from(a)
+    const builtInBlock = result.built_in_block
     return {
-        blockHeights: result.block_heights,
-        builtInBlock: result.built_in_block,
-        blockStartAddress: result.block_start_address,
-        blockLoopIndents: result.block_loop_indents,
+        blockHeights: toInt32Array(result.block_heights),
+        builtInBlock: builtInBlock instanceof Uint8Array ? builtInBlock : Uint8Array.from(builtInBlock, (b: boolean) => b ? 1 : 0),
+        blockStartAddress: toInt32Array(result.block_start_address),
+        blockLoopIndents: toInt32Array(result.block_loop_indents),
         blockTypes: result.block_types,
     };
 }
 
+// The minimap of the blocks [window.startBlock, window.endBlock) at the finest level with at most maxBuckets buckets
+export async function getMinimapTile(filepath: string, order: BLOCK_ORDERS, window: {startBlock: number, endBlock: number}, maxBuckets: number) : Promise<MinimapTileType> {
+    const response = await fetchAnalyzed(
+        apiURL + "getminimaptile/" + order, {
+            method: 'POST',
+            headers: encodedHeaders,
+            body: JSON.stringify({
+                path: filepath,
+                start_block: window.startBlock,
+                end_block: window.endBlock,
+                max_buckets: maxBuckets,
+            }),
+        }
+    );
+    const result = await decodeResponse(response);
+
+    const toInt32Array = (a: Int32Array | number[]) => a instanceof Int32Array ? a : Int32Array.from(a)
+    return {
+        level: result.level,
+        bucketBlocks: result.bucket_blocks,
+        startBucket: result.start_bucket,
+        nBuckets: result.n_buckets,
+        startAddress: toInt32Array(result.start_address),
+        instructions: toInt32Array(result.instructions),
+        builtInBlocks: toInt32Array(result.built_in_blocks),
+        loopDepth: toInt32Array(result.loop_depth),
+        typeBits: toInt32Array(result.type_bits),
+        dominantType: toInt32Array(result.dominant_type),
+    };
+}
+
 export async function getAddressRange(filepath: string) : Promise<{start: number, end: number}> {
-    const response = await fetch(
+    const response = await fetchAnalyzed(
         apiURL + "addressrange", {
             method: 'POST',
             headers: {
@@ -56,14 +131,19 @@ export async function getAddressRange(filepath: string) : Promise<{start: number
     return result;
 }
 
-export async function getSourceLines(binaryFile: string, sourceFile: string): Promise<SourceFile> {
-    const response = await fetch(
+// The lines [startLine, endLine) of sourceFile, or all of them without a range
+export async function getSourceLines(binaryFile: string, sourceFile: string, range?: {startLine: number, endLine: number}): Promise<SourceFile> {
+    const response = await fetchAnalyzed(
         apiURL + "getsourcefile", {
             method: 'POST',
             headers: {
                 'Content-Type': 'application/json',
             },
-            body: JSON.stringify({filepath: {path:sourceFile}, binary_file_path: {path:binaryFile}}),
+            body: JSON.stringify({
+                filepath: {path:sourceFile},
+                binary_file_path: {path:binaryFile},
+                ...(range && {start_line: range.startLine, end_line: range.endLine}),
+            }),
         }
     );
     const result = await response.json();
@@ -71,67 +151,59 @@ export async function getSourceLines(binaryFile: string, sourceFile: string): Pr
 }
 
 export async function getDisassemblyPage(filepath: string, pageNo: number, order: BLOCK_ORDERS): Promise<BlockPage> {
-    const response = await fetch(
+    const response = await fetchAnalyzed(
         apiURL + "getdisassemblypage/" + order + '/' + pageNo, {
             method: 'POST',
-            headers: {
-                'Content-Type': 'application/json',
-            },
+            headers: encodedHeaders,
             body: JSON.stringify({path:filepath}),
         }
     );
-    const result: Object = await response.json();
+    const result: Object = await decodeResponse(response);
     const blockPage = await plainToInstance(BlockPage, result, { excludeExtraneousValues: true })
     return blockPage;
 }
 
 export async function getDisassemblyBlock(filepath: string, blockId: string, order: BLOCK_ORDERS): Promise<InstructionBlock> {
-    const response = await fetch(
+    const response = await fetchAnalyzed(
         apiURL + "getdisassemblyblockbyid/" + order, {
             method: 'POST',
-            headers: {
-                'Content-Type': 'application/json',
-            },
+            headers: encodedHeaders,
             body: JSON.stringify({
                 path: filepath,
                 blockId: blockId,
             }),
         }
     );
-    const result: Object = await response.json();
+    const result: Object = await decodeResponse(response);
     const block = await plainToInstance(InstructionBlock, result, { excludeExtraneousValues: true })
     return block;
 }
 
 export async function getDisassemblyPageByAddress(filepath: string, startAddress: number, order: BLOCK_ORDERS): Promise<BlockPage> {
-    const response = await fetch(
+    const response = await fetchAnalyzed(
         apiURL + "getdisassemblypagebyaddress/" + order + "/" + startAddress, {
             method: 'POST',
-            headers: {
-                'Content-Type': 'application/json',
-            },
+            headers: encodedHeaders,
             body: JSON.stringify({path:filepath}),
         }
     );
-    const result: Object = await response.json();
+    const result: Object = await decodeResponse(response);
     const blockPage = await plainToInstance(BlockPage, result, { excludeExtraneousValues: true })
     return blockPage;
 }
 
 export async function getDisassemblyBlockByAddress(filepath: string, order: BLOCK_ORDERS, blockStartAddress: number): Promise<InstructionBlock> {
-    const response = await fetch(
+    const response = await fetchAnalyzed(
         apiURL + "getdisassemblyblockbyaddress/" + order, {
             method: 'POST',
-            headers: {
-                'Content-Type': 'application/json',
-            },
+            headers: encodedHeaders,
             body: JSON.stringify({
                 path: filepath,
                 blockStartAddress: blockStartAddress,
             }),
         }
     );
-    const result: Object = await response.json();
+    const result: Object = await decodeResponse(response);
     const block = await plainToInstance(InstructionBlock, result, { excludeExtraneousValues: true })
     return block;
 }
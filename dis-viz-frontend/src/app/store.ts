@@ -1,6 +1,6 @@
 import { configureStore, ThunkAction, Action } from '@reduxjs/toolkit';
 import selectionsReducer from '../features/selections/selectionsSlice';
-import minimapReducer from '../features/minimap/minimapSlice';
+import minimapReducer, { initBlocks } from '../features/minimap/minimapSlice';
 import binaryFilePathReducer from '../features/binary-data/binaryDataSlice';
 
 export const store = configureStore({
@@ -9,6 +9,17 @@ export const store = configureStore({
     binaryFilePath: binaryFilePathReducer,
     minimap: minimapReducer,
   },
+  // The minimap keeps its blocks in typed arrays, which the dev checks would
+  // otherwise report as non-serializable and walk element by element
+  middleware: getDefaultMiddleware => getDefaultMiddleware({
+    serializableCheck: {
+      ignoredActions: [initBlocks.type],
+      ignoredPaths: ['minimap.value'],
+    },
+    immutableCheck: {
+      ignoredPaths: ['minimap.value'],
+    },
+  }),
 });
 
 export type AppDispatch = typeof store.dispatch;
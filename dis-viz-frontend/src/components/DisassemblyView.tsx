@@ -9,9 +9,9 @@ import Minimap from './Minimap';
 import DisassemblyBlock from './DisassemblyBlock';
 import { useAppDispatch, useAppSelector } from '../app/hooks';
 import { Form, Button } from 'react-bootstrap';
-import { MinimapType } from '../features/minimap/minimapSlice';
+import { MinimapTileType } from '../features/minimap/minimapSlice';
 import { isHex, toHex } from '../utils';
-import { marginHorizontal, LOOP_INDENT_SIZE, BLOCK_MAX_WIDTH } from '../config';
+import { marginHorizontal, LOOP_INDENT_SIZE, BLOCK_MAX_WIDTH, BLOCKS_PER_PAGE, MINIMAP_MARGIN_BLOCKS } from '../config';
 
 
 
@@ -90,7 +90,8 @@ function DisassemblyView({ id }:{
     const disassemblyBlockRefs = React.useRef<{[start_address: number]: { div: HTMLDivElement, idx: number }}>({})
     const onScreenFirstBlockAddress = useVisibleBlockWindow(disassemblyBlockRefs)
     const [backedges, setBackedges] = React.useState<{[pageBlockIdx: string]: HTMLDivElement[]}>({})
-    const [minimap, setMinimap] = React.useState<MinimapType>()
+    const [minimapTile, setMinimapTile] = React.useState<MinimapTileType>()
+    const requestedMinimapTile = React.useRef<{binaryFilePath: string, order: BLOCK_ORDERS, startBlock: number, endBlock: number}>()
 
     const [jumpAddress, setJumpAddress] = React.useState<string>('0x0')
     const [jumpValidationError, setJumpValidationError] = React.useState('')
@@ -128,9 +129,41 @@ function DisassemblyView({ id }:{
         })
     }
     
+    // Position in the order of the first visible block, -1 while none is
+    const visibleStartBlock = (() => {
+        for (const page of pages) {
+            const j = page.blocks.findIndex(block => block.start_address === onScreenFirstBlockAddress.startAddress)
+            if (j >= 0) return page.page_no * BLOCKS_PER_PAGE + j
+        }
+        return -1
+    })()
+    const visibleEndBlock = visibleStartBlock + onScreenFirstBlockAddress.nBlocks
+
+    // Fetch the minimap of the visible blocks with a margin around them, again once
+    // the visible blocks come within half a margin of the edge of the last request
     React.useEffect(() => {
-        api.getMinimapData(binaryFilePath, blockOrder).then(setMinimap)
-    }, [binaryFilePath, blockOrder])
+        if (visibleStartBlock < 0) return
+        const requested = requestedMinimapTile.current
+        if (requested && requested.binaryFilePath === binaryFilePath && requested.order === blockOrder) {
+            if ((requested.startBlock === 0 || visibleStartBlock >= requested.startBlock + MINIMAP_MARGIN_BLOCKS / 2) &&
+                visibleEndBlock <= requested.endBlock - MINIMAP_MARGIN_BLOCKS / 2)
+                return
+        }
+        else {
+            setMinimapTile(undefined)
+        }
+        const request = {
+            binaryFilePath,
+            order: blockOrder,
+            startBlock: Math.max(visibleStartBlock - MINIMAP_MARGIN_BLOCKS, 0),
+            endBlock: visibleEndBlock + MINIMAP_MARGIN_BLOCKS,
+        }
+        requestedMinimapTile.current = request
+        // As many buckets as blocks, so the tile is of level 0 with a bucket per block
+        api.getMinimapTile(binaryFilePath, blockOrder, request, request.endBlock - request.startBlock).then(tile => {
+            if (requestedMinimapTile.current === request) setMinimapTile(tile)
+        })
+    }, [binaryFilePath, blockOrder, visibleStartBlock, visibleEndBlock])
 
     const activeRef = React.useRef<HTMLInputElement>(null);
     React.useEffect(() => {
@@ -314,10 +347,11 @@ function DisassemblyView({ id }:{
             {finalPages.length > 0 && !finalPages[finalPages.length-1].is_last?<button onClick={e => {addNewPage(finalPages[finalPages.length-1].page_no+1)}}>
                 Load more
             </button>:<></>}
-            {minimap && onScreenFirstBlockAddress.nBlocks > 0 && <Minimap
+            {minimapTile && onScreenFirstBlockAddress.nBlocks > 0 && minimapTile.startBucket <= visibleStartBlock &&
+                visibleStartBlock < minimapTile.startBucket + minimapTile.startAddress.length && <Minimap
                 width={150}
-                visibleBlockWindow={onScreenFirstBlockAddress}
-                minimap={minimap}
+                visibleBlockWindow={{ startBlock: visibleStartBlock, nBlocks: onScreenFirstBlockAddress.nBlocks }}
+                tile={minimapTile}
                 order={blockOrder}
             ></Minimap>}
             </div> :
@@ -6,6 +6,7 @@ import '../styles/inputsourcefilepath.css'
 import { selectBinaryFilePath, setBinaryFilePath } from '../features/binary-data/binaryDataSlice'
 import { initBlocks } from '../features/minimap/minimapSlice'
 import { useAppSelector, useAppDispatch } from '../app/hooks'
+import { ANALYSIS_POLL_INTERVAL } from '../config'
 
 function InputFilePath() {
     const [binaryList, setBinaryList] = React.useState<{
@@ -26,6 +27,27 @@ function InputFilePath() {
         fetchBinaryList().catch(console.error);
     }, [binaryList]);
 
+    // Poll the analysis of the selected binary, which the views wait for, until it is done
+    const [analysisStatus, setAnalysisStatus] = React.useState<api.AnalysisStatus>()
+    React.useEffect(() => {
+        setAnalysisStatus(undefined)
+        if(binaryFilePath === "") return;
+        let cancelled = false
+        const pollStatus = async () => {
+            for (;;) {
+                const status = await api.getAnalysisStatus(binaryFilePath)
+                if (cancelled) return
+                setAnalysisStatus(status)
+                if (status.ready || status.phase === 'failed') return
+                await new Promise(resolve => setTimeout(resolve, ANALYSIS_POLL_INTERVAL))
+            }
+        }
+        pollStatus().catch(console.error);
+        return () => {
+            cancelled = true
+        }
+    }, [binaryFilePath]);
+
     return <div style={{ margin: "25px" }}>
         <Form.Group className="mb-3">
             <Form.Label>Binary File Path</Form.Label>
@@ -45,6 +67,11 @@ function InputFilePath() {
                     <option key={i} value={d.executable_path}>{d.name}</option>
                 )}
             </Form.Select>
+            {analysisStatus && !analysisStatus.ready && <Form.Text>
+                {analysisStatus.phase === 'failed' ? 'Analysis failed' : 'Analyzing (' + analysisStatus.phase + ')'}
+                {analysisStatus.phase !== 'failed' && analysisStatus.functions_total > 0 &&
+                    ': ' + analysisStatus.functions_done + ' / ' + analysisStatus.functions_total + ' functions'}
+            </Form.Text>}
         </Form.Group>
     </div>
 }
@@ -1,5 +1,5 @@
 import React from 'react';
-import { MinimapType, selectMinimap } from '../features/minimap/minimapSlice'
+import { MinimapTileType, INSTRUCTION_FLAG_BITS } from '../features/minimap/minimapSlice'
 import { selectSelections, selectActiveDisassemblyView } from '../features/selections/selectionsSlice'
 import { codeColors, hexToHSL } from '../utils'
 import { setDisassemblyLineSelection } from '../features/selections/selectionsSlice'
@@ -31,11 +31,13 @@ function canvas_arrow(context: CanvasRenderingContext2D, fromx: number, fromy: n
 }
 
 
-export default function Minimap({ minimap, visibleBlockWindow, width, order, ...props }: {
-    minimap: MinimapType,
+// Draws the blocks of a level 0 tile around the visible blocks. Block indices are
+// positions in the order; the tile holds the blocks [tile.startBucket, tile.startBucket + tile.startAddress.length)
+export default function Minimap({ tile, visibleBlockWindow, width, order, ...props }: {
+    tile: MinimapTileType,
     width: number,
     order: BLOCK_ORDERS,
-    visibleBlockWindow: { startAddress: number, nBlocks: number }
+    visibleBlockWindow: { startBlock: number, nBlocks: number }
 }) {
     const dispatch = useAppDispatch();
     const currentDisViewId = useAppSelector(selectActiveDisassemblyView)
@@ -43,8 +45,12 @@ export default function Minimap({ minimap, visibleBlockWindow, width, order, ...
     const canvasRef = React.useRef<HTMLCanvasElement>(null)
     const selections = useAppSelector(selectSelections)
 
-    const totalBlocks = minimap.blockStartAddress.length // b
-    const brushStartBlockI = minimap.blockStartAddress.findIndex(address => address === visibleBlockWindow.startAddress)
+    const totalBlocks = tile.nBuckets // b
+    const tileStartBlockI = tile.startBucket
+    const tileEndBlockI = tile.startBucket + tile.startAddress.length - 1
+    const blockHeightAt = (i: number) => tile.instructions[i - tileStartBlockI]
+    const blockStartAddressAt = (i: number) => tile.startAddress[i - tileStartBlockI]
+    const brushStartBlockI = visibleBlockWindow.startBlock
     const brushEndBlockI = brushStartBlockI + visibleBlockWindow.nBlocks - 1
 
     const [highlightOption, setHighlightOption] = React.useState("none")
@@ -60,20 +66,20 @@ export default function Minimap({ minimap, visibleBlockWindow, width, order, ...
         let topHeight: number = brushStartBlockI / totalBlocks * height - BLOCKS_START_TOP - BRUSH_OFFSET - BLOCK_SEP
         while (topHeight > 100) {
             drawingStartBlockI -= 1
-            if (drawingStartBlockI < 0) {
-                drawingStartBlockI = 0
+            if (drawingStartBlockI < tileStartBlockI) {
+                drawingStartBlockI = tileStartBlockI
                 break
             }
-            topHeight -= minimap.blockHeights[drawingStartBlockI] * BLOCK_LINE_HEIGHT_FACTOR + BLOCK_SEP
+            topHeight -= blockHeightAt(drawingStartBlockI) * BLOCK_LINE_HEIGHT_FACTOR + BLOCK_SEP
         }
         let bottomHeight: number = height - brushStartBlockI / totalBlocks * height
         while (bottomHeight > -100) {
             drawingEndBlockI += 1
-            if (drawingEndBlockI >= totalBlocks) {
-                drawingEndBlockI = totalBlocks - 1
+            if (drawingEndBlockI > tileEndBlockI) {
+                drawingEndBlockI = tileEndBlockI
                 break
             }
-            bottomHeight -= minimap.blockHeights[drawingEndBlockI] * BLOCK_LINE_HEIGHT_FACTOR + BLOCK_SEP
+            bottomHeight -= blockHeightAt(drawingEndBlockI) * BLOCK_LINE_HEIGHT_FACTOR + BLOCK_SEP
         }
     }
 
@@ -81,10 +87,10 @@ export default function Minimap({ minimap, visibleBlockWindow, width, order, ...
     for (const disViewId in selections) {
         const selection = selections[disViewId]
         if (selection) {
-            if (selection.addresses.some(address => address < minimap.blockStartAddress[drawingStartBlockI])) {
+            if (selection.addresses.some(address => address < blockStartAddressAt(drawingStartBlockI))) {
                 topHidden.push(parseInt(disViewId))
             }
-            if (selection.addresses.some(address => address > minimap.blockStartAddress[drawingEndBlockI])) {
+            if (selection.addresses.some(address => address > blockStartAddressAt(drawingEndBlockI))) {
                 bottomHidden.push(parseInt(disViewId))
             }
         }
@@ -97,12 +103,12 @@ export default function Minimap({ minimap, visibleBlockWindow, width, order, ...
         ctx.fillStyle = "#FFFFFF"
 
         let cumulativeHeight = 0;
-        minimap.blockHeights.forEach((blockHeight, i) => {
-            if (i < drawingStartBlockI || i > drawingEndBlockI) return
-
+        for (let i = drawingStartBlockI; i <= drawingEndBlockI; i++) {
+            const k = i - tileStartBlockI
+            const blockHeight = tile.instructions[k]
 
             const curBlock = i - drawingStartBlockI
-            const x = BLOCK_LINE_LEFT + minimap.blockLoopIndents[i] * LOOP_INDENT_SIZE
+            const x = BLOCK_LINE_LEFT + tile.loopDepth[k] * LOOP_INDENT_SIZE
             const y = BLOCKS_START_TOP + curBlock * BLOCK_SEP + cumulativeHeight + blockHeight * BLOCK_LINE_HEIGHT_FACTOR / 2
 
             // Detect if the brush should start here
@@ -124,14 +130,14 @@ export default function Minimap({ minimap, visibleBlockWindow, width, order, ...
             }
             ctx.moveTo(x, y)
 
-            ctx.strokeStyle = minimap.builtInBlock[i] === true ? "lightgrey" : "grey"
+            ctx.strokeStyle = tile.builtInBlocks[k] ? "lightgrey" : "grey"
             for (const disViewId in selections) {
                 const addresses = selections[disViewId]?.addresses
                 if (addresses === undefined || addresses.length === 0) continue
                 for (const address of addresses) {
-                    if (minimap.blockStartAddress[i] <= address && (i >= minimap.blockStartAddress.length || address <= minimap.blockStartAddress[i + 1])) {
+                    if (tile.startAddress[k] <= address && (k + 1 >= tile.startAddress.length || address <= tile.startAddress[k + 1])) {
                         const { h, s, l } = hexToHSL(codeColors[disViewId])
-                        if (minimap.builtInBlock[i])
+                        if (tile.builtInBlocks[k])
                             ctx.strokeStyle = "hsl(" + Math.max(h - 10, 0) + "," + s + "%," + l + "%)"
                         else
                             ctx.strokeStyle = "hsl(" + h + "," + s + "%," + Math.max(l - 20, 0) + "%)"
@@ -140,13 +146,13 @@ export default function Minimap({ minimap, visibleBlockWindow, width, order, ...
                 }
             }
 
-            if (highlightOption === "VEC" && minimap.blockTypes[i].includes("vectorized"))
+            if (highlightOption === "VEC" && tile.typeBits[k] & INSTRUCTION_FLAG_BITS.vectorized)
                 ctx.strokeStyle = "cyan"
-            else if (highlightOption === "Mem_Read" && minimap.blockTypes[i].includes("memory_read"))
+            else if (highlightOption === "Mem_Read" && tile.typeBits[k] & INSTRUCTION_FLAG_BITS.memoryRead)
                 ctx.strokeStyle = "purple"
-            else if (highlightOption === "Mem_Write" && minimap.blockTypes[i].includes("memory_write"))
+            else if (highlightOption === "Mem_Write" && tile.typeBits[k] & INSTRUCTION_FLAG_BITS.memoryWrite)
                 ctx.strokeStyle = "orange"
-            else if (highlightOption === "Syscall" && minimap.blockTypes[i].includes("syscall"))
+            else if (highlightOption === "Syscall" && tile.typeBits[k] & INSTRUCTION_FLAG_BITS.syscall)
                 ctx.strokeStyle = "red"
 
             ctx.lineWidth = (blockHeight === 0 ? 1 : blockHeight) * BLOCK_LINE_HEIGHT_FACTOR
@@ -154,7 +160,7 @@ export default function Minimap({ minimap, visibleBlockWindow, width, order, ...
             ctx.stroke()
 
             cumulativeHeight += (blockHeight === 0 ? 1 : blockHeight) * BLOCK_LINE_HEIGHT_FACTOR
-        })
+        }
 
         // move the brush div
         if (!brushDragging && brushStartY !== null && brushEndY !== null) {
@@ -229,16 +235,15 @@ export default function Minimap({ minimap, visibleBlockWindow, width, order, ...
         let blockI = drawingStartBlockI
         let cumulativeHeight = 0
         while (blockI < drawingEndBlockI) {
-            const blockHeight = minimap.blockHeights[blockI]
-            if (y < BLOCKS_START_TOP + cumulativeHeight + blockHeight * BLOCK_LINE_HEIGHT_FACTOR / 2) {
+            if (y < BLOCKS_START_TOP + cumulativeHeight + blockHeightAt(blockI) * BLOCK_LINE_HEIGHT_FACTOR / 2) {
                 break
             }
-            cumulativeHeight += blockHeight * BLOCK_LINE_HEIGHT_FACTOR + BLOCK_SEP
+            cumulativeHeight += blockHeightAt(blockI) * BLOCK_LINE_HEIGHT_FACTOR + BLOCK_SEP
             blockI += 1
         }
         
         // get instruction addresses from blockI
-        const addresses = [minimap.blockStartAddress[blockI]]
+        const addresses = [blockStartAddressAt(blockI)]
         api.getDisassemblyBlockByAddress(binaryFilePath, order, addresses[0])
             .then(block => {
                 const sourceLines: { [source_file: string] : number[] } = {}
@@ -15,6 +15,18 @@ export function getUrls() {
 }
 
 
+// Opt in to the compact MessagePack encoding for disassembly and minimap data instead of JSON
+export const USE_MSGPACK = false
+
+// Milliseconds between retries of a request while the backend is still analyzing the binary
+export const ANALYSIS_POLL_INTERVAL = 500
+
+// Blocks of every disassembly page but the last, BLOCKS_PER_PAGE of the backend
+export const BLOCKS_PER_PAGE = 100
+
+// Blocks fetched for the minimap on either side of the visible ones
+export const MINIMAP_MARGIN_BLOCKS = 500
+
 export const marginHorizontal = 10 //10
 export const marginSameVertical = 10 // 10
 export const marginDifferentVertical = 100 //100
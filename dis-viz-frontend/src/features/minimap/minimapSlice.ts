@@ -3,23 +3,48 @@ import { RootState } from '../../app/store';
 import * as api from '../../api'
 
 export type MinimapType = {
-    blockHeights: number[],
-    builtInBlock: boolean[],
-    blockStartAddress: number[],
-    blockLoopIndents: number[],
+    blockHeights: Int32Array,
+    builtInBlock: Uint8Array,
+    blockStartAddress: Int32Array,
+    blockLoopIndents: Int32Array,
     blockTypes: string[][]
 }
 
+// A window of one level of the minimap pyramid. Bucket i covers the blocks
+// [(startBucket + i) * bucketBlocks, (startBucket + i + 1) * bucketBlocks)
+export type MinimapTileType = {
+    level: number,
+    bucketBlocks: number,
+    startBucket: number,
+    nBuckets: number,
+    startAddress: Int32Array,
+    instructions: Int32Array,
+    builtInBlocks: Int32Array,
+    loopDepth: Int32Array,
+    typeBits: Int32Array,       // bit i set when an instruction has INSTRUCTION_FLAGS i
+    dominantType: Int32Array,   // INSTRUCTION_FLAGS of the most instructions, -1 for none
+}
+
+// Bits of MinimapTileType.typeBits, by INSTRUCTION_FLAGS of the backend
+export const INSTRUCTION_FLAG_BITS = {
+    vectorized: 1 << 0,
+    memoryRead: 1 << 1,
+    memoryWrite: 1 << 2,
+    call: 1 << 3,
+    syscall: 1 << 4,
+    fp: 1 << 5,
+}
+
 export interface Minimap {
     value: MinimapType
 }
 
 const initialState: Minimap = {
     value: {
-        blockHeights: [],
-        builtInBlock: [],
-        blockStartAddress: [],
-        blockLoopIndents: [],
+        blockHeights: new Int32Array(),
+        builtInBlock: new Uint8Array(),
+        blockStartAddress: new Int32Array(),
+        blockLoopIndents: new Int32Array(),
         blockTypes: []
     }
 }
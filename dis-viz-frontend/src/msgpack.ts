@@ -0,0 +1,104 @@
+// Decoder for the MessagePack responses of the backend, sent when a request
+// accepts MSGPACK_MIME. Packed numeric arrays arrive as ext values and are
+// returned as typed arrays.
+export const MSGPACK_MIME = 'application/msgpack'
+
+const EXT_INT32_ARRAY = 1
+const EXT_BOOL_ARRAY = 2
+
+class Decoder {
+    private bytes: Uint8Array
+    private view: DataView
+    private pos = 0
+    private text = new TextDecoder()
+
+    constructor(private buffer: ArrayBuffer) {
+        this.bytes = new Uint8Array(buffer)
+        this.view = new DataView(buffer)
+    }
+
+    value(): any {
+        const type = this.bytes[this.pos++]
+        if (type < 0x80) return type
+        if (type < 0x90) return this.map(type & 0x0f)
+        if (type < 0xa0) return this.array(type & 0x0f)
+        if (type < 0xc0) return this.str(type & 0x1f)
+        if (type >= 0xe0) return type - 0x100
+
+        switch (type) {
+            case 0xc0: return null
+            case 0xc2: return false
+            case 0xc3: return true
+            case 0xc7: return this.ext(this.uint(1))
+            case 0xc8: return this.ext(this.uint(2))
+            case 0xc9: return this.ext(this.uint(4))
+            case 0xcc: return this.uint(1)
+            case 0xcd: return this.uint(2)
+            case 0xce: return this.uint(4)
+            case 0xcf: return this.uint(4) * 2 ** 32 + this.uint(4)
+            case 0xd0: return this.int(1)
+            case 0xd1: return this.int(2)
+            case 0xd2: return this.int(4)
+            case 0xd3: return this.int(4) * 2 ** 32 + this.uint(4)
+            case 0xd9: return this.str(this.uint(1))
+            case 0xda: return this.str(this.uint(2))
+            case 0xdb: return this.str(this.uint(4))
+            case 0xdc: return this.array(this.uint(2))
+            case 0xdd: return this.array(this.uint(4))
+            case 0xde: return this.map(this.uint(2))
+            case 0xdf: return this.map(this.uint(4))
+        }
+        throw new Error('Unsupported MessagePack type 0x' + type.toString(16))
+    }
+
+    private uint(size: 1 | 2 | 4): number {
+        const pos = this.pos
+        this.pos += size
+        if (size === 1) return this.view.getUint8(pos)
+        if (size === 2) return this.view.getUint16(pos)
+        return this.view.getUint32(pos)
+    }
+
+    private int(size: 1 | 2 | 4): number {
+        const pos = this.pos
+        this.pos += size
+        if (size === 1) return this.view.getInt8(pos)
+        if (size === 2) return this.view.getInt16(pos)
+        return this.view.getInt32(pos)
+    }
+
+    private str(size: number): string {
+        const s = this.text.decode(this.bytes.subarray(this.pos, this.pos + size))
+        this.pos += size
+        return s
+    }
+
+    private array(size: number): any[] {
+        const result = new Array(size)
+        for (let i = 0; i < size; i++) result[i] = this.value()
+        return result
+    }
+
+    private map(size: number): { [key: string]: any } {
+        const result: { [key: string]: any } = {}
+        for (let i = 0; i < size; i++) {
+            const key = this.value()
+            result[key] = this.value()
+        }
+        return result
+    }
+
+    // Packed arrays are little-endian. slice copies them to an aligned buffer.
+    private ext(size: number): Int32Array | Uint8Array {
+        const type = this.uint(1)
+        const data = this.buffer.slice(this.pos, this.pos + size)
+        this.pos += size
+        if (type === EXT_INT32_ARRAY) return new Int32Array(data)
+        if (type === EXT_BOOL_ARRAY) return new Uint8Array(data)
+        throw new Error('Unsupported MessagePack ext type ' + type)
+    }
+}
+
+export function decode(buffer: ArrayBuffer): any {
+    return new Decoder(buffer).value()
+}